@@ -0,0 +1,417 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -DHAL_SIMULATED -o BlinkEngineTest BlinkEngineTest.c GpioHal.c BlinkMetrics.c BlinkTrace.c RunArena.c EdgeTelemetry.c -lpthread
+Step 3: ./BlinkEngineTest
+
+Runs the blink engine of NewStudent.c (runExperiment()) against the simulated backend and checks every call it made
+in halSimCalls: each edge of each LED has to go out at its ideal time (start epoch + phase offset + edge offset, worked
+out here from the frequency, brightness and phase rather than taken from the engine's timing table) with the right
+state and PWM value, edges of both LEDs due on the same tick have to share one halWritePins() call,
+every LED has to emit exactly the edges of its schedule, and the end the engine returns (where a run queued behind
+starts) has to be the slot after the last edge of the LED that finishes last.
+
+The drift cases then run one hour at 10Hz under every late edge policy, once undisturbed and once with a single 250ms
+stall halfway through. The last edge of each LED has to land within one scheduler tick (LATE_THRESHOLD_US) of its
+ideal time, except under stretch after a stall, where the whole rest of the schedule moves back by the stall.
+Prints one line per case and exits with 1 if any failed.
+*/
+
+#ifndef HAL_SIMULATED
+#error "BlinkEngineTest checks the calls recorded by the simulated backend, build it with -DHAL_SIMULATED"
+#endif
+
+#define NEW_STUDENT_NO_MAIN
+#include "NewStudent.c"
+
+#include <stdarg.h>
+
+// Definitions
+#define MAX_LATENESS_NS 20000 // Virtual time the loop itself may take between a deadline and the write (a few clock reads)
+#define ROUNDING_NS 2         // Difference allowed between the engine's integer edge times and the ones worked out here
+#define MAX_REPORTED 5        // Failures printed per case before the rest are only counted
+#define OFF -1                // Configuration of an LED that does not blink in a case
+#define DRIFT_RUN_SECONDS 3600 // Length of the drift cases (the drift target is for a one hour run at 10Hz)
+#define STALL_AT_SECONDS 1800  // When the stalled drift cases stall
+#define STALL_MS 250           // How long they stall (several 10Hz edges are missed)
+
+// One experiment to run and check
+typedef struct
+{
+    const char *name;
+    int frequencies[NUMBER_OF_LEDS];
+    int brightness[NUMBER_OF_LEDS];
+    int phases[NUMBER_OF_LEDS];
+} TestCase;
+
+// One long run to check for drift
+typedef struct
+{
+    const char *name;
+    int latePolicy;
+    unsigned int stallMs; // Length of the stall halfway through (0 for none)
+} DriftCase;
+
+// Function Prototypes
+int runCase(const TestCase *test);
+int runDriftCase(const DriftCase *test);
+int checkCalls(Experiment *experiment, unsigned long long epoch, unsigned long firstCall, unsigned long lastCall);
+int ledOfPin(int pin);
+double idealOffsetNanos(unsigned int frequency, unsigned int brightness, unsigned long edge);
+double idealPhaseNanos(unsigned int frequency, unsigned int phase);
+unsigned long idealEdgeCount(unsigned int frequency, unsigned int brightness, unsigned int durationSeconds);
+void reportFailure(int *failures, const char *format, ...);
+
+const TestCase testCases[] = {
+    {"anti-phase 10Hz 50%", {10, 10}, {50, 50}, {0, 180}},
+    {"green only 1Hz 25%", {1, OFF}, {25, OFF}, {0, OFF}},
+    {"red only 3Hz 80%, 90 degrees", {OFF, 3}, {OFF, 80}, {OFF, 90}},
+    {"7Hz 30% against 3Hz 100%", {7, 3}, {30, 100}, {0, 90}},
+    {"off and full brightness", {5, 2}, {0, 100}, {45, 0}},
+    {"in phase 500Hz 50%", {500, 500}, {50, 50}, {90, 90}},
+};
+
+const DriftCase driftCases[] = {
+    {"1h at 10Hz, catch up", LATE_CATCH_UP, 0},
+    {"1h at 10Hz, skip", LATE_SKIP, 0},
+    {"1h at 10Hz, stretch", LATE_STRETCH, 0},
+    {"1h at 10Hz, catch up, stall", LATE_CATCH_UP, STALL_MS},
+    {"1h at 10Hz, skip, stall", LATE_SKIP, STALL_MS},
+    {"1h at 10Hz, stretch, stall", LATE_STRETCH, STALL_MS},
+};
+
+int main(void)
+{
+    if (halSetup() < 0)
+    {
+        printf("Error: Could not set up the simulated backend.\n");
+        return 1;
+    }
+    engineMetrics = registerMetricsThread("engine");
+
+    int failedCases = 0;
+    int caseCount = sizeof(testCases) / sizeof(testCases[0]);
+    for (int c = 0; c < caseCount; c++)
+    {
+        int failures = runCase(&testCases[c]);
+        printf("%-32s %s\n", testCases[c].name, failures == 0 ? "OK" : "FAILED");
+        failedCases += failures != 0;
+    }
+
+    int driftCaseCount = sizeof(driftCases) / sizeof(driftCases[0]);
+    for (int c = 0; c < driftCaseCount; c++)
+    {
+        failedCases += runDriftCase(&driftCases[c]) != 0;
+    }
+    caseCount += driftCaseCount;
+
+    printf("\n%d of %d cases passed\n", caseCount - failedCases, caseCount);
+    return failedCases == 0 ? 0 : 1;
+}
+
+// Runs one case through runExperiment() and checks the calls it made. Returns the number of failed checks
+int runCase(const TestCase *test)
+{
+    Experiment *experiment = calloc(1, sizeof(Experiment));
+    if (experiment == NULL)
+    {
+        printf("Error: Not enough memory for the experiment.\n");
+        return 1;
+    }
+
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        experiment->frequencies[i] = (unsigned int)test->frequencies[i];
+        experiment->brightness[i] = (unsigned int)test->brightness[i];
+        experiment->phases[i] = (unsigned int)test->phases[i];
+        experiment->active[i] = test->frequencies[i] != OFF;
+        experiment->files[i] = -1;
+    }
+    experiment->durationSeconds = BLINK_DURATION;
+    experiment->latePolicy = LATE_CATCH_UP;
+    if (prepareRunBuffers(&experiment->buffers, experiment->frequencies, experiment->brightness, experiment->active, experiment->durationSeconds) < 0)
+    {
+        free(experiment);
+        return 1;
+    }
+
+    unsigned long firstCall = halSimCallCount;
+    unsigned long long epoch = halNanos() + ARM_DELAY_US * 1000ULL;
+    unsigned long long scheduledEnd = runExperiment(experiment, epoch);
+    unsigned long lastCall = halSimCallCount;
+
+    int failures = 0;
+    if (lastCall > HAL_SIM_MAX_CALLS)
+    {
+        printf("  %lu calls do not fit in the call log of %d\n", lastCall, HAL_SIM_MAX_CALLS);
+        failures++;
+    }
+    else
+    {
+        failures += checkCalls(experiment, epoch, firstCall, lastCall);
+    }
+
+    // The run ends on the slot after the last edge of whichever LED finishes last
+    double idealEnd = 0;
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (experiment->active[i])
+        {
+            unsigned long edges = idealEdgeCount(experiment->frequencies[i], experiment->brightness[i], experiment->durationSeconds);
+            double end = idealPhaseNanos(experiment->frequencies[i], experiment->phases[i]) + idealOffsetNanos(experiment->frequencies[i], experiment->brightness[i], edges);
+            idealEnd = end > idealEnd ? end : idealEnd;
+        }
+    }
+    double endError = (double)(scheduledEnd - epoch) - idealEnd;
+    if (endError < -ROUNDING_NS || endError > ROUNDING_NS)
+    {
+        reportFailure(&failures, "  Scheduled end %lluns after the epoch, ideal end %.0fns\n", scheduledEnd - epoch, idealEnd);
+    }
+
+    discardExperiment(experiment);
+    return failures;
+}
+
+// Runs one hour of two anti-phase 10Hz LEDs under one late edge policy and checks the drift of the last edge of each.
+// Returns the number of failed checks
+int runDriftCase(const DriftCase *test)
+{
+    Experiment *experiment = calloc(1, sizeof(Experiment));
+    if (experiment == NULL)
+    {
+        printf("Error: Not enough memory for the experiment.\n");
+        return 1;
+    }
+
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        experiment->frequencies[i] = 10;
+        experiment->brightness[i] = 50;
+        experiment->phases[i] = i == GREEN ? 0 : 180;
+        experiment->active[i] = TRUE;
+        experiment->files[i] = -1;
+    }
+    experiment->durationSeconds = DRIFT_RUN_SECONDS;
+    experiment->latePolicy = test->latePolicy;
+    if (prepareRunBuffers(&experiment->buffers, experiment->frequencies, experiment->brightness, experiment->active, experiment->durationSeconds) < 0)
+    {
+        free(experiment);
+        return 1;
+    }
+
+    unsigned long long epoch = halNanos() + ARM_DELAY_US * 1000ULL;
+    unsigned long long stallNanos = test->stallMs * 1000000ULL;
+    if (stallNanos > 0)
+    {
+        halSimStall(epoch + STALL_AT_SECONDS * 1000000000ULL, stallNanos);
+    }
+    runExperiment(experiment, epoch);
+
+    int failures = 0;
+    double worstDriftNanos = 0;
+    RunBuffers *buffers = &experiment->buffers;
+    RunResults *results = &experiment->results;
+    double tickNanos = LATE_THRESHOLD_US * 1000.0;
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        // Every slot of the schedule is either emitted or, under skip, dropped
+        unsigned long expected = idealEdgeCount(experiment->frequencies[i], experiment->brightness[i], experiment->durationSeconds);
+        if (results->edgesEmitted[i] + results->skippedEdges[i] != expected || buffers->recorded[i] != results->edgesEmitted[i])
+        {
+            reportFailure(&failures, "  LED %d: %lu edges emitted and %lu skipped, expected %lu\n", i, results->edgesEmitted[i], results->skippedEdges[i], expected);
+            continue;
+        }
+
+        // The stall is the only thing that may make edges late, and only skip drops any
+        if ((results->lateEdges[i] > 0) != (stallNanos > 0))
+        {
+            reportFailure(&failures, "  LED %d: %lu late edges\n", i, results->lateEdges[i]);
+        }
+        if ((results->skippedEdges[i] > 0) != (stallNanos > 0 && test->latePolicy == LATE_SKIP))
+        {
+            reportFailure(&failures, "  LED %d: %lu skipped edges\n", i, results->skippedEdges[i]);
+        }
+
+        // Drift of the last edge against its ideal time, worked out here rather than taken from the drift report
+        EdgeRecord *last = &buffers->records[i][buffers->recorded[i] - 1];
+        double idealNanos = idealPhaseNanos(experiment->frequencies[i], experiment->phases[i]) + idealOffsetNanos(experiment->frequencies[i], experiment->brightness[i], expected - 1);
+        double driftNanos = (double)last->timeNanos - idealNanos;
+        double allowedNanos = test->latePolicy == LATE_STRETCH ? stallNanos : 0; // Stretch moves the rest of the schedule back by the stall
+        if (driftNanos < allowedNanos - ROUNDING_NS || driftNanos > allowedNanos + tickNanos)
+        {
+            reportFailure(&failures, "  LED %d: last edge %.1fus after its ideal time, expected %.1fus to %.1fus\n", i, driftNanos / 1000.0, allowedNanos / 1000.0, (allowedNanos + tickNanos) / 1000.0);
+        }
+        worstDriftNanos = driftNanos > worstDriftNanos ? driftNanos : worstDriftNanos;
+    }
+
+    printf("%-32s %s (drift at the last edge: %.1fus)\n", test->name, failures == 0 ? "OK" : "FAILED", worstDriftNanos / 1000.0);
+    discardExperiment(experiment);
+    return failures;
+}
+
+// Replays the recorded calls of one run against the schedule of every LED. Returns the number of failed checks
+int checkCalls(Experiment *experiment, unsigned long long epoch, unsigned long firstCall, unsigned long lastCall)
+{
+    RunBuffers *buffers = &experiment->buffers;
+    unsigned long nextEdges[NUMBER_OF_LEDS] = {0, 0}; // Edge of each LED the next write should carry
+    int pwmWritten[NUMBER_OF_LEDS] = {FALSE, FALSE};  // Flag to check if the PWM value of the coming edge was written
+    int failures = 0;
+
+    for (unsigned long c = firstCall; c < lastCall; c++)
+    {
+        HalCall *call = &halSimCalls[c];
+
+        if (call->type == HAL_CALL_PWM_WRITE)
+        {
+            int led = ledOfPin(call->pin);
+            if (led < 0 || !experiment->active[led] || nextEdges[led] >= buffers->capacity[led])
+            {
+                reportFailure(&failures, "  PWM write to GPIO%d with no edge due\n", call->pin);
+                continue;
+            }
+
+            int state = edgeState(experiment->brightness[led], nextEdges[led]);
+            int expected = state == HIGH ? (int)experiment->brightness[led] : 0;
+            if (call->value != expected)
+            {
+                reportFailure(&failures, "  LED %d edge %lu: PWM value %d, expected %d\n", led, nextEdges[led], call->value, expected);
+            }
+            pwmWritten[led] = TRUE;
+        }
+        else if (call->type == HAL_CALL_WRITE_PINS)
+        {
+            unsigned int setMask = (unsigned int)call->pin;
+            unsigned int clearMask = (unsigned int)call->value;
+            unsigned int ledMask = 0;
+
+            for (int i = 0; i < NUMBER_OF_LEDS; i++)
+            {
+                unsigned int bit = 1u << ledPins[i];
+                ledMask |= bit;
+                if (!((setMask | clearMask) & bit))
+                {
+                    continue;
+                }
+
+                if (!experiment->active[i] || nextEdges[i] >= buffers->capacity[i])
+                {
+                    reportFailure(&failures, "  LED %d written after its last edge\n", i);
+                    continue;
+                }
+
+                // State and time of the edge against the schedule
+                unsigned long edge = nextEdges[i];
+                int state = edgeState(experiment->brightness[i], edge);
+                if (((setMask & bit) != 0) != (state == HIGH) || (setMask & clearMask & bit))
+                {
+                    reportFailure(&failures, "  LED %d edge %lu: wrong state (set %08x, clear %08x)\n", i, edge, setMask, clearMask);
+                }
+
+                double idealNanos = idealPhaseNanos(experiment->frequencies[i], experiment->phases[i]) + idealOffsetNanos(experiment->frequencies[i], experiment->brightness[i], edge);
+                double latenessNanos = (double)(call->timeNs - epoch) - idealNanos;
+                if (latenessNanos < -ROUNDING_NS || latenessNanos > MAX_LATENESS_NS)
+                {
+                    reportFailure(&failures, "  LED %d edge %lu: written at %lluns, ideal time %.0fns\n", i, edge, call->timeNs - epoch, idealNanos);
+                }
+                if (!pwmWritten[i])
+                {
+                    reportFailure(&failures, "  LED %d edge %lu: no PWM write before the pin write\n", i, edge);
+                }
+
+                pwmWritten[i] = FALSE;
+                nextEdges[i]++;
+            }
+
+            if ((setMask | clearMask) & ~ledMask)
+            {
+                reportFailure(&failures, "  Write to pins that are not LEDs (set %08x, clear %08x)\n", setMask, clearMask);
+            }
+
+            // An LED that was also due by now had to go out in this same write
+            for (int i = 0; i < NUMBER_OF_LEDS; i++)
+            {
+                if (experiment->active[i] && nextEdges[i] < buffers->capacity[i])
+                {
+                    unsigned long long deadline = epoch + phaseOffsetNanos(experiment->frequencies[i], experiment->phases[i]) + buffers->offsets[i][nextEdges[i]];
+                    if (deadline < call->timeNs)
+                    {
+                        reportFailure(&failures, "  LED %d edge %lu was due but left out of the write at %lluns\n", i, nextEdges[i], call->timeNs - epoch);
+                    }
+                }
+            }
+        }
+    }
+
+    // Every LED has to have emitted exactly its schedule, on time
+    RunResults *results = &experiment->results;
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        unsigned long expected = experiment->active[i] ? idealEdgeCount(experiment->frequencies[i], experiment->brightness[i], experiment->durationSeconds) : 0;
+        if (nextEdges[i] != expected || results->edgesEmitted[i] != expected)
+        {
+            reportFailure(&failures, "  LED %d: %lu edges written and %lu reported, expected %lu\n", i, nextEdges[i], results->edgesEmitted[i], expected);
+        }
+        if (results->lateEdges[i] != 0)
+        {
+            reportFailure(&failures, "  LED %d: %lu late edges\n", i, results->lateEdges[i]);
+        }
+    }
+    if (results->cancelled)
+    {
+        reportFailure(&failures, "  Run reported as cancelled\n");
+    }
+    return failures;
+}
+
+// Ideal time of an edge after the LED's start, from its settings alone
+double idealOffsetNanos(unsigned int frequency, unsigned int brightness, unsigned long edge)
+{
+    double cycleNanos = 1e9 / (frequency > 0 ? frequency : 1);
+    if (brightness == 0 || brightness >= 100)
+    {
+        return edge * cycleNanos; // A constant LED still records one edge per cycle
+    }
+    return (edge / 2) * cycleNanos + (edge % 2 == 1 ? cycleNanos * brightness / 100.0 : 0);
+}
+
+// Ideal start of an LED after the epoch, from its phase offset in degrees
+double idealPhaseNanos(unsigned int frequency, unsigned int phase)
+{
+    return 1e9 / (frequency > 0 ? frequency : 1) * phase / 360.0;
+}
+
+// Edges an LED has to emit in a run of the given length
+unsigned long idealEdgeCount(unsigned int frequency, unsigned int brightness, unsigned int durationSeconds)
+{
+    unsigned long edges = 0;
+    while (idealOffsetNanos(frequency, brightness, edges) < durationSeconds * 1e9 - ROUNDING_NS)
+    {
+        edges++;
+    }
+    return edges;
+}
+
+// LED driven by a pin, or -1 if no LED is on it
+int ledOfPin(int pin)
+{
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (ledPins[i] == pin)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Counts a failed check and prints it, unless MAX_REPORTED failures of the case were printed already
+void reportFailure(int *failures, const char *format, ...)
+{
+    if ((*failures)++ < MAX_REPORTED)
+    {
+        va_list arguments;
+        va_start(arguments, format);
+        vprintf(format, arguments);
+        va_end(arguments);
+    }
+}
@@ -0,0 +1,194 @@
+/*
+=== BLINK ENGINE METRICS ===
+See BlinkMetrics.h for how the counters are recorded and read.
+*/
+
+#include "BlinkMetrics.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+// Definitions
+#define REPORT_INTERVAL_SECONDS 1 // How often the snapshot file is refreshed
+
+// Slots claimed by registerMetricsThread(). Threads past METRICS_MAX_THREADS share the overflow slot, which is never reported
+static MetricsSlot slots[METRICS_MAX_THREADS];
+static MetricsSlot overflowSlot;
+static atomic_int slotCount;
+
+// Reporter thread state
+static pthread_t reporterThread;
+static pthread_mutex_t reporterLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reporterWake = PTHREAD_COND_INITIALIZER;
+static int reporterRunning = 0;
+static int reporterStopping = 0;
+static char reportPath[256];
+static char reportChannelNames[METRICS_MAX_CHANNELS][METRICS_NAME_LENGTH];
+static int reportChannelCount;
+static struct timespec reportStart;
+
+// Function Prototypes
+static void *runReporter(void *argument);
+static void writeSnapshot();
+
+// Claims a metrics slot for the calling thread. Call once per thread before recording anything
+MetricsSlot *registerMetricsThread(const char *name)
+{
+    int index = atomic_fetch_add(&slotCount, 1);
+    if (index >= METRICS_MAX_THREADS)
+    {
+        return &overflowSlot;
+    }
+
+    MetricsSlot *slot = &slots[index];
+    strncpy(slot->name, name, METRICS_NAME_LENGTH - 1);
+    if (pthread_getcpuclockid(pthread_self(), &slot->cpuClock) != 0)
+    {
+        slot->cpuClock = CLOCK_THREAD_CPUTIME_ID; // Falls back to the reporter's own CPU time, which is at least harmless
+    }
+    return slot;
+}
+
+// Starts the thread that refreshes the snapshot file at path once a second. Returns 0 on success and -1 on failure
+int startMetricsReporter(const char *path, const char *channelNames[], int channelCount)
+{
+    if (reporterRunning)
+    {
+        return 0;
+    }
+
+    strncpy(reportPath, path, sizeof(reportPath) - 1);
+    reportChannelCount = channelCount < METRICS_MAX_CHANNELS ? channelCount : METRICS_MAX_CHANNELS;
+    for (int i = 0; i < reportChannelCount; i++)
+    {
+        strncpy(reportChannelNames[i], channelNames[i], METRICS_NAME_LENGTH - 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &reportStart);
+
+    reporterStopping = 0;
+    if (pthread_create(&reporterThread, NULL, runReporter, NULL) != 0)
+    {
+        return -1;
+    }
+    reporterRunning = 1;
+    return 0;
+}
+
+// Writes a final snapshot and stops the reporter thread
+void stopMetricsReporter()
+{
+    if (!reporterRunning)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&reporterLock);
+    reporterStopping = 1;
+    pthread_cond_signal(&reporterWake);
+    pthread_mutex_unlock(&reporterLock);
+
+    pthread_join(reporterThread, NULL);
+    reporterRunning = 0;
+}
+
+// Refreshes the snapshot every REPORT_INTERVAL_SECONDS until stopped
+static void *runReporter(void *argument)
+{
+    (void)argument;
+    struct timespec wakeTime;
+    clock_gettime(CLOCK_REALTIME, &wakeTime); // pthread_cond_timedwait() uses the realtime clock by default
+
+    pthread_mutex_lock(&reporterLock);
+    while (!reporterStopping)
+    {
+        wakeTime.tv_sec += REPORT_INTERVAL_SECONDS;
+        pthread_cond_timedwait(&reporterWake, &reporterLock, &wakeTime);
+
+        pthread_mutex_unlock(&reporterLock);
+        writeSnapshot();
+        pthread_mutex_lock(&reporterLock);
+    }
+    pthread_mutex_unlock(&reporterLock);
+    return NULL;
+}
+
+// Sums every slot and replaces the snapshot file
+static void writeSnapshot()
+{
+    char tempPath[sizeof(reportPath) + 4];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", reportPath);
+
+    FILE *file = fopen(tempPath, "w");
+    if (file == NULL)
+    {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double uptime = (now.tv_sec - reportStart.tv_sec) + (now.tv_nsec - reportStart.tv_nsec) / 1e9;
+
+    unsigned long edges[METRICS_MAX_CHANNELS] = {0};
+    unsigned long missedDeadlines = 0;
+    unsigned long maxLatenessUs = 0;
+    unsigned long writerQueueDepth = 0;
+    unsigned long bytesWritten = 0;
+    unsigned long writes = 0;
+    unsigned long writeMicrosTotal = 0;
+    unsigned long writeNanosMax = 0;
+
+    int threads = atomic_load(&slotCount);
+    threads = threads < METRICS_MAX_THREADS ? threads : METRICS_MAX_THREADS;
+
+    for (int t = 0; t < threads; t++)
+    {
+        MetricsSlot *slot = &slots[t];
+        for (int i = 0; i < reportChannelCount; i++)
+        {
+            edges[i] += atomic_load_explicit(&slot->edges[i], memory_order_relaxed);
+        }
+        missedDeadlines += atomic_load_explicit(&slot->missedDeadlines, memory_order_relaxed);
+        writerQueueDepth += atomic_load_explicit(&slot->writerQueueDepth, memory_order_relaxed);
+        bytesWritten += atomic_load_explicit(&slot->bytesWritten, memory_order_relaxed);
+        writes += atomic_load_explicit(&slot->writes, memory_order_relaxed);
+        writeMicrosTotal += atomic_load_explicit(&slot->writeMicrosTotal, memory_order_relaxed);
+
+        unsigned long lateness = atomic_load_explicit(&slot->maxLatenessUs, memory_order_relaxed);
+        unsigned long writeNanos = atomic_load_explicit(&slot->writeNanosMax, memory_order_relaxed);
+        maxLatenessUs = lateness > maxLatenessUs ? lateness : maxLatenessUs;
+        writeNanosMax = writeNanos > writeNanosMax ? writeNanos : writeNanosMax;
+    }
+
+    fprintf(file, "# Blink engine metrics, refreshed every %d second(s)\n", REPORT_INTERVAL_SECONDS);
+    fprintf(file, "uptime_seconds %.1f\n", uptime);
+    for (int i = 0; i < reportChannelCount; i++)
+    {
+        fprintf(file, "edges_total{channel=\"%s\"} %lu\n", reportChannelNames[i], edges[i]);
+    }
+    fprintf(file, "missed_deadlines_total %lu\n", missedDeadlines);
+    fprintf(file, "max_lateness_us %lu\n", maxLatenessUs);
+    fprintf(file, "writer_queue_depth %lu\n", writerQueueDepth);
+    fprintf(file, "bytes_written_total %lu\n", bytesWritten);
+    fprintf(file, "file_writes_total %lu\n", writes);
+    fprintf(file, "file_write_avg_us %.1f\n", writes > 0 ? (double)writeMicrosTotal / writes : 0.0);
+    fprintf(file, "file_write_max_us %.1f\n", writeNanosMax / 1000.0);
+
+    // CPU time of each registered thread (the blink engine thread is the PWM engine)
+    for (int t = 0; t < threads; t++)
+    {
+        struct timespec cpu;
+        if (clock_gettime(slots[t].cpuClock, &cpu) == 0)
+        {
+            fprintf(file, "cpu_seconds{thread=\"%s\"} %.3f\n", slots[t].name, cpu.tv_sec + cpu.tv_nsec / 1e9);
+        }
+    }
+
+    // Whole process, including the softPwm threads created by wiringPi
+    struct timespec processCpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &processCpu);
+    fprintf(file, "cpu_seconds{thread=\"process\"} %.3f\n", processCpu.tv_sec + processCpu.tv_nsec / 1e9);
+
+    fclose(file);
+    rename(tempPath, reportPath); // Atomic replace so readers never see a partial snapshot
+}
@@ -0,0 +1,66 @@
+/*
+=== BLINK ENGINE METRICS ===
+Cheap runtime counters and gauges for the blink engine in NewStudent.c.
+
+Every thread that records metrics claims its own cache-line aligned slot with registerMetricsThread().
+Only the owning thread ever writes to its slot, so updates are plain relaxed loads and stores (no locks, no
+read-modify-write instructions). A reporter thread sums all slots once a second and writes a text snapshot
+to a file, replacing it atomically so readers never see half a snapshot:
+
+  watch -n 1 cat blink_metrics.txt
+
+=== HOW TO USE ===
+gcc -o YourTool YourTool.c BlinkMetrics.c -lpthread
+*/
+
+#ifndef BLINK_METRICS_H
+#define BLINK_METRICS_H
+
+#include <stdatomic.h>
+#include <time.h>
+
+#define METRICS_MAX_THREADS 8  // Maximum number of threads that can record metrics
+#define METRICS_MAX_CHANNELS 8 // Maximum number of LED channels that are counted separately
+#define METRICS_NAME_LENGTH 16 // Maximum length of a thread or channel name (including '\0')
+
+// Counters and gauges owned by one thread
+typedef struct
+{
+    _Alignas(64) char name[METRICS_NAME_LENGTH];        // Name of the owning thread
+    clockid_t cpuClock;                                 // CPU time clock of the owning thread
+    atomic_ulong edges[METRICS_MAX_CHANNELS];           // Edges emitted per channel
+    atomic_ulong missedDeadlines;                       // Edges emitted after their deadline
+    atomic_ulong maxLatenessUs;                         // Worst lateness of any edge in microseconds
+    atomic_ulong writerQueueDepth;                      // Records waiting to be written to disk
+    atomic_ulong bytesWritten;                          // Bytes written to waveform files
+    atomic_ulong writes;                                // Number of file writes
+    atomic_ulong writeMicrosTotal;                      // Total time spent in file writes in microseconds
+    atomic_ulong writeNanosMax;                         // Slowest file write in nanoseconds
+} MetricsSlot;
+
+MetricsSlot *registerMetricsThread(const char *name);
+int startMetricsReporter(const char *path, const char *channelNames[], int channelCount);
+void stopMetricsReporter();
+
+// Adds value to a counter owned by the calling thread
+static inline void metricsAdd(atomic_ulong *counter, unsigned long value)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+// Sets a gauge owned by the calling thread
+static inline void metricsSet(atomic_ulong *gauge, unsigned long value)
+{
+    atomic_store_explicit(gauge, value, memory_order_relaxed);
+}
+
+// Raises a high-water mark owned by the calling thread
+static inline void metricsMax(atomic_ulong *gauge, unsigned long value)
+{
+    if (value > atomic_load_explicit(gauge, memory_order_relaxed))
+    {
+        atomic_store_explicit(gauge, value, memory_order_relaxed);
+    }
+}
+
+#endif
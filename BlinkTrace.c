@@ -0,0 +1,149 @@
+/*
+=== BLINK TRACE CAPTURE ===
+See BlinkTrace.h for how tracing is enabled.
+*/
+
+#include "BlinkTrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef BLINK_TRACE
+
+// Tracing state
+int traceEnabled = 0;
+__thread TraceBuffer *traceBuffer = NULL;
+static TraceBuffer buffers[TRACE_MAX_THREADS];
+static TraceEvent *traceEvents; // Events of every buffer, allocated in one block by startTrace()
+static atomic_int bufferCount;
+static char tracePath[256];
+static unsigned long long traceStartNs;
+
+// Enables tracing if path is set. Returns 0 on success (or when tracing stays off) and -1 on failure
+int startTrace(const char *path)
+{
+    if (path == NULL || path[0] == '\0')
+    {
+        return 0;
+    }
+
+    // Every thread's buffer is allocated and touched here, so recording never allocates or takes a page fault
+    traceEvents = malloc((size_t)TRACE_MAX_THREADS * TRACE_EVENTS_PER_THREAD * sizeof(TraceEvent));
+    if (traceEvents == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate the trace buffers\n");
+        return -1;
+    }
+    memset(traceEvents, 0, (size_t)TRACE_MAX_THREADS * TRACE_EVENTS_PER_THREAD * sizeof(TraceEvent));
+    for (int t = 0; t < TRACE_MAX_THREADS; t++)
+    {
+        buffers[t].events = traceEvents + (size_t)t * TRACE_EVENTS_PER_THREAD;
+    }
+
+    strncpy(tracePath, path, sizeof(tracePath) - 1);
+    traceStartNs = traceNow();
+    traceEnabled = 1;
+
+    if (claimTraceBuffer("main") == NULL)
+    {
+        traceEnabled = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Gives the calling thread the next of the buffers preallocated by startTrace(). Returns NULL if every buffer is taken
+TraceBuffer *claimTraceBuffer(const char *name)
+{
+    if (traceBuffer != NULL)
+    {
+        strncpy(traceBuffer->name, name, sizeof(traceBuffer->name) - 1); // Already claimed, just rename
+        return traceBuffer;
+    }
+
+    int index = atomic_fetch_add(&bufferCount, 1);
+    if (index >= TRACE_MAX_THREADS)
+    {
+        return NULL;
+    }
+
+    TraceBuffer *buffer = &buffers[index];
+    strncpy(buffer->name, name, sizeof(buffer->name) - 1);
+
+    traceBuffer = buffer;
+    return buffer;
+}
+
+// Writes every recorded event as a Chrome trace-event JSON file and stops tracing
+void stopTrace()
+{
+    if (!traceEnabled)
+    {
+        return;
+    }
+    traceEnabled = 0;
+
+    FILE *file = fopen(tracePath, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error: Could not write trace file %s\n", tracePath);
+        return;
+    }
+
+    int threads = atomic_load(&bufferCount);
+    threads = threads < TRACE_MAX_THREADS ? threads : TRACE_MAX_THREADS;
+    unsigned long dropped = 0;
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (int t = 0; t < threads; t++)
+    {
+        TraceBuffer *buffer = &buffers[t];
+        dropped += buffer->dropped;
+
+        // Metadata event so the viewer shows the thread name
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", t == 0 ? "" : ",\n", t + 1, buffer->name);
+
+        for (unsigned int i = 0; i < buffer->count; i++)
+        {
+            TraceEvent *event = &buffer->events[i];
+            double startUs = (event->startNs - traceStartNs) / 1000.0;
+
+            if (event->durationNs == 0)
+            {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", event->name, startUs, t + 1);
+            }
+            else
+            {
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}", event->name, startUs, event->durationNs / 1000.0, t + 1);
+            }
+        }
+        buffer->events = NULL;
+    }
+    free(traceEvents);
+    traceEvents = NULL;
+    fprintf(file, "\n],\"otherData\":{\"droppedEvents\":%lu}}\n", dropped);
+    fclose(file);
+
+    printf("Trace written to %s", tracePath);
+    if (dropped > 0)
+    {
+        printf(" (%lu events dropped, buffers were full)", dropped);
+    }
+    printf("\n");
+}
+
+#else
+
+// Tracing is compiled out, so there is nothing to start or stop
+int startTrace(const char *path)
+{
+    (void)path;
+    return 0;
+}
+
+void stopTrace()
+{
+}
+
+#endif
@@ -0,0 +1,103 @@
+/*
+=== BLINK TRACE CAPTURE ===
+Opt-in timeline of what the program was doing: scheduler wakeups, GPIO writes, PWM updates,
+file flushes and serial operations are recorded as timestamped spans.
+
+Tracing is compiled in with -DBLINK_TRACE and switched on at runtime by naming the output file:
+  gcc -DBLINK_TRACE -o NewStudent NewStudent.c BlinkMetrics.c BlinkTrace.c -lwiringPi -lpthread
+  BLINK_TRACE_FILE=trace.json ./NewStudent
+
+Each thread records into its own buffer. All of them are allocated and touched by TRACE_START, so recording
+an event is two clock reads and a few stores. When the program exits the buffers are written out as a Chrome
+trace-event JSON file, which can be opened in chrome://tracing or https://ui.perfetto.dev
+
+Without -DBLINK_TRACE every TRACE_ macro expands to nothing.
+*/
+
+#ifndef BLINK_TRACE_H
+#define BLINK_TRACE_H
+
+#define TRACE_MAX_THREADS 8          // Maximum number of threads with their own buffer
+#define TRACE_EVENTS_PER_THREAD 65536 // Events each thread can record before further events are dropped
+
+int startTrace(const char *path);
+void stopTrace();
+
+#ifdef BLINK_TRACE
+
+#include <stdatomic.h>
+#include <time.h>
+
+// One recorded span. Names must be string literals since only the pointer is stored
+typedef struct
+{
+    unsigned long long startNs; // Start of the span on the monotonic clock
+    unsigned int durationNs;    // Length of the span (0 for instant events)
+    const char *name;           // Name of the span
+} TraceEvent;
+
+// Preallocated events of one thread
+typedef struct
+{
+    char name[16];               // Name of the thread shown in the viewer
+    unsigned int count;          // Events recorded
+    unsigned int dropped;        // Events lost because the buffer was full
+    TraceEvent *events;          // TRACE_EVENTS_PER_THREAD events
+} TraceBuffer;
+
+extern int traceEnabled;
+extern __thread TraceBuffer *traceBuffer;
+TraceBuffer *claimTraceBuffer(const char *name);
+
+// Current time of the monotonic clock in nanoseconds
+static inline unsigned long long traceNow()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Records a span that started at startNs and ends now
+static inline void traceSpan(const char *name, unsigned long long startNs, int instant)
+{
+    TraceBuffer *buffer = traceBuffer;
+    if (buffer == NULL)
+    {
+        buffer = claimTraceBuffer("thread"); // Threads that never named themselves get a generic name (only takes an index)
+        if (buffer == NULL)
+        {
+            return;
+        }
+    }
+
+    if (buffer->count >= TRACE_EVENTS_PER_THREAD)
+    {
+        buffer->dropped++;
+        return;
+    }
+
+    TraceEvent *event = &buffer->events[buffer->count++];
+    event->startNs = startNs;
+    event->durationNs = instant ? 0 : (unsigned int)(traceNow() - startNs);
+    event->name = name;
+}
+
+#define TRACE_START() startTrace(getenv("BLINK_TRACE_FILE"))
+#define TRACE_STOP() stopTrace()
+#define TRACE_THREAD(threadName) (traceEnabled ? (void)claimTraceBuffer(threadName) : (void)0)
+#define TRACE_BEGIN(span) unsigned long long span##TraceStart = traceEnabled ? traceNow() : 0
+#define TRACE_END(span, spanName) (traceEnabled ? traceSpan(spanName, span##TraceStart, 0) : (void)0)
+#define TRACE_INSTANT(spanName) (traceEnabled ? traceSpan(spanName, traceNow(), 1) : (void)0)
+
+#else
+
+#define TRACE_START() ((void)0)
+#define TRACE_STOP() ((void)0)
+#define TRACE_THREAD(threadName) ((void)0)
+#define TRACE_BEGIN(span) ((void)0)
+#define TRACE_END(span, spanName) ((void)0)
+#define TRACE_INSTANT(spanName) ((void)0)
+
+#endif
+
+#endif
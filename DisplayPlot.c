@@ -1,12 +1,102 @@
+/*
+=== HOW TO RUN ===
+gcc -o DisplayPlot DisplayPlot.c WaveformCsv.c -lpthread
+
+Plot green_waveform_data.csv and red_waveform_data.csv into PlottedWaveform.png:
+./DisplayPlot
+
+Batch mode, for a whole characterisation report: every CSV file given (or found in a given directory) is parsed once
+and rendered on a pool of threads (one per core) into name.png next to it, and all of them are combined into ReportGrid.png
+in the first directory given (or the directory of the first file). Symbolic links in a directory, such as the
+green_waveform_data.csv link to the newest run, are skipped so no recording is drawn twice.
+Every image uses the same time axis so the recordings can be compared directly, and each recording is drawn in the
+colour of its LED (from the title, or else the file name):
+./DisplayPlot recordings/
+./DisplayPlot run1.csv run2.csv run3.csv
+*/
+
+#include "WaveformCsv.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Definitions
+#define TRUE 1
+#define FALSE 0
+
+#define MAX_BATCH_FILES 256       // Maximum number of recordings in one batch
+#define MAX_BATCH_THREADS 64      // Maximum size of the thread pool
+#define PLOT_ROW_LENGTH 48        // Longest row of gnuplot data produced for one CSV row
+#define GRID_IMAGE "ReportGrid.png"   // Written to the directory of the first recording given
+#define GRID_CELL_WIDTH 800       // Size of each recording in the grid image
+#define GRID_CELL_HEIGHT 400
+#define OTHER_LED_COLOR "blue"    // Line colour of a recording that is neither the green nor the red LED
+
+// One recording in batch mode
+typedef struct
+{
+    char path[512];                     // CSV file
+    char title[WAVEFORM_TITLE_LENGTH];  // Dataset title from the first line
+    const char *lineColor;              // Gnuplot colour of the LED the recording is from
+    char *plotData;                     // Rows as "time state" lines, sent straight to gnuplot
+    size_t plotDataLength;
+    double firstMillis;                 // Time range of this recording
+    double lastMillis;
+    double minMillis;                   // Time range shared by every recording
+    double maxMillis;
+} BatchJob;
+
+// Work shared by the threads of the pool
+typedef struct
+{
+    void (*task)(BatchJob *job);
+    BatchJob *jobs;
+    int jobCount;
+    atomic_int nextJob;
+} BatchPool;
+
+// Function Prototypes
+int plotDefaultRecordings();
+int plotBatch(int argc, char *argv[]);
+int collectRecordings(const char *path, BatchJob jobs[], int jobCount);
+int compareJobs(const void *a, const void *b);
+int workerCount();
+void runOnPool(void (*task)(BatchJob *job), BatchJob jobs[], int jobCount, int threads);
+void *runPoolWorker(void *argument);
+void parseJob(BatchJob *job);
+const char *ledLineColor(const char *title, const char *path);
+int containsWord(const char *text, const char *word);
+void gridImagePath(const char *argument, char *gridPath, size_t size);
+void quoteForGnuplot(const char *text, char *quoted, size_t size);
+void writeAxes(FILE *gnuplotPipe, double minMillis, double maxMillis);
+void renderJob(BatchJob *job);
+void renderGrid(BatchJob jobs[], int jobCount, double minMillis, double maxMillis, const char *gridPath);
 
-int main()
+int main(int argc, char *argv[])
 {
-    // Open the CSV files for reading to retrieve the dataset names
-    FILE *greenFile = fopen("green_waveform_data.csv", "r"); // Same name as saved in your device for green led dataset
-    FILE *redFile = fopen("red_waveform_data.csv", "r");     // Same name as saved in your device for red led dataset
+    if (argc > 1)
+    {
+        return plotBatch(argc, argv);
+    }
+    return plotDefaultRecordings();
+}
+
+// Plots the green and red recordings of the last run into PlottedWaveform.png
+int plotDefaultRecordings()
+{
+    // Load the CSV files to retrieve the dataset names and check that they contain data
+    WaveformData greenData; // Same name as saved in your device for green led dataset
+    WaveformData redData;   // Same name as saved in your device for red led dataset
+    int greenFile = loadWaveformCsv("green_waveform_data.csv", &greenData) == 0 && greenData.count > 0;
+    int redFile = loadWaveformCsv("red_waveform_data.csv", &redData) == 0 && redData.count > 0;
     if (!greenFile && !redFile)
     {
         printf("Error: No CSV files available to visualise.\n");
@@ -37,43 +127,32 @@ int main()
         return 0;
     }
 
-    char greenDataName[256]; // Assuming a maximum name length of 255 characters for green led dataset
-    char redDataName[256];   // Assuming a maximum name length of 255 characters for red led dataset
-
     if (greenFile)
     {
-        // Read the first line of each CSV file to get the dataset Title
-        if (fgets(greenDataName, sizeof(greenDataName), greenFile) != NULL)
-        {
-            greenDataName[strcspn(greenDataName, "\n")] = '\0'; // Remove the newline character
-        }
-
-        // Close the CSV file
-        fclose(greenFile);
+        // The first line of the CSV file is the dataset Title
+        char greenDataName[2 * WAVEFORM_TITLE_LENGTH];
+        quoteForGnuplot(greenData.title, greenDataName, sizeof(greenDataName));
 
         // First subplot of green led
         fprintf(gnuplotPipe, "set origin 0.0,0.5\n");
         fprintf(gnuplotPipe, "set size 1,0.5\n");
         fprintf(gnuplotPipe, "set ylabel 'High and Low State'\n");
         fprintf(gnuplotPipe, "plot 'green_waveform_data.csv' using 1:2 with steps title '(%s)' linecolor 'dark-green'\n", greenDataName);
+        freeWaveformData(&greenData);
     }
 
     if (redFile)
     {
-        // Read the first line of each CSV file to get the dataset Title
-        if (fgets(redDataName, sizeof(redDataName), redFile) != NULL)
-        {
-            redDataName[strcspn(redDataName, "\n")] = '\0'; // Remove the newline character
-        }
-
-        // Close the CSV file
-        fclose(redFile);
+        // The first line of the CSV file is the dataset Title
+        char redDataName[2 * WAVEFORM_TITLE_LENGTH];
+        quoteForGnuplot(redData.title, redDataName, sizeof(redDataName));
 
         // Second subplot of red led
         fprintf(gnuplotPipe, "set origin 0.0,0.0\n");
         fprintf(gnuplotPipe, "set size 1,0.5\n");
         fprintf(gnuplotPipe, "set ylabel 'High and Low State'\n");
         fprintf(gnuplotPipe, "plot 'red_waveform_data.csv' using 1:2 with steps title '(%s)' linecolor 'red'\n", redDataName);
+        freeWaveformData(&redData);
     }
 
     fprintf(gnuplotPipe, "unset multiplot\n");
@@ -84,3 +163,364 @@ int main()
 
     return 0;
 }
+
+// Renders every recording given on the command line (files or directories of CSV files) on a pool of threads,
+// then combines them into one grid image with the same axes for every recording
+int plotBatch(int argc, char *argv[])
+{
+    BatchJob jobs[MAX_BATCH_FILES];
+    int jobCount = 0;
+
+    // Collecting the recordings
+    for (int i = 1; i < argc; i++)
+    {
+        jobCount = collectRecordings(argv[i], jobs, jobCount);
+    }
+    if (jobCount == 0)
+    {
+        printf("Error: No CSV files available to visualise.\n");
+        return 0;
+    }
+
+    int threads = workerCount();
+    printf("Rendering %d recordings on %d threads...\n", jobCount, threads);
+
+    // Phase 1: every file is parsed exactly once and turned into gnuplot data
+    runOnPool(parseJob, jobs, jobCount, threads);
+
+    // Every image shares the time range of all recordings together
+    double minMillis = 0;
+    double maxMillis = 0;
+    int first = TRUE;
+    for (int i = 0; i < jobCount; i++)
+    {
+        if (jobs[i].plotData != NULL)
+        {
+            minMillis = first || jobs[i].firstMillis < minMillis ? jobs[i].firstMillis : minMillis;
+            maxMillis = first || jobs[i].lastMillis > maxMillis ? jobs[i].lastMillis : maxMillis;
+            first = FALSE;
+        }
+    }
+    if (first)
+    {
+        printf("Error: None of the CSV files contained waveform data.\n");
+        return 0;
+    }
+    if (maxMillis <= minMillis)
+    {
+        maxMillis = minMillis + 1;
+    }
+    for (int i = 0; i < jobCount; i++)
+    {
+        jobs[i].minMillis = minMillis;
+        jobs[i].maxMillis = maxMillis;
+    }
+
+    // Phase 2: the individual images
+    runOnPool(renderJob, jobs, jobCount, threads);
+
+    // Phase 3: the combined grid, next to the recordings rather than in the current directory
+    char gridPath[sizeof(jobs[0].path)];
+    gridImagePath(argv[1], gridPath, sizeof(gridPath));
+    renderGrid(jobs, jobCount, minMillis, maxMillis, gridPath);
+
+    for (int i = 0; i < jobCount; i++)
+    {
+        free(jobs[i].plotData);
+    }
+    return 0;
+}
+
+// Adds path (a CSV file, or every CSV file in a directory) to jobs. Returns the new number of jobs
+int collectRecordings(const char *path, BatchJob jobs[], int jobCount)
+{
+    DIR *directory = opendir(path);
+    if (directory == NULL)
+    {
+        if (jobCount < MAX_BATCH_FILES)
+        {
+            memset(&jobs[jobCount], 0, sizeof(BatchJob));
+            snprintf(jobs[jobCount].path, sizeof(jobs[jobCount].path), "%s", path);
+            jobCount++;
+        }
+        return jobCount;
+    }
+
+    int firstJob = jobCount;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL && jobCount < MAX_BATCH_FILES)
+    {
+        size_t length = strlen(entry->d_name);
+        if (length > 4 && strcmp(entry->d_name + length - 4, ".csv") == 0)
+        {
+            memset(&jobs[jobCount], 0, sizeof(BatchJob));
+            snprintf(jobs[jobCount].path, sizeof(jobs[jobCount].path), "%s/%s", path, entry->d_name);
+
+            // The "latest run" links point at a numbered file in the same directory, which is rendered anyway
+            struct stat status;
+            if (lstat(jobs[jobCount].path, &status) == 0 && S_ISLNK(status.st_mode))
+            {
+                continue;
+            }
+            jobCount++;
+        }
+    }
+    closedir(directory);
+
+    // Directory order is arbitrary, so sort by name to keep the grid layout stable between runs
+    qsort(&jobs[firstJob], jobCount - firstJob, sizeof(BatchJob), compareJobs);
+    return jobCount;
+}
+
+// Orders jobs by path for qsort()
+int compareJobs(const void *a, const void *b)
+{
+    return strcmp(((const BatchJob *)a)->path, ((const BatchJob *)b)->path);
+}
+
+// Number of threads in the pool (one per online core)
+int workerCount()
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+#else
+    return 4;
+#endif
+}
+
+// Runs task on every job, with each of the threads taking the next unclaimed job until none are left
+void runOnPool(void (*task)(BatchJob *job), BatchJob jobs[], int jobCount, int threads)
+{
+    BatchPool pool = {task, jobs, jobCount, 0};
+    pthread_t workers[MAX_BATCH_THREADS];
+    threads = threads < MAX_BATCH_THREADS ? threads : MAX_BATCH_THREADS;
+    threads = threads < jobCount ? threads : jobCount;
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_create(&workers[i], NULL, runPoolWorker, &pool);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+}
+
+// One thread of the pool
+void *runPoolWorker(void *argument)
+{
+    BatchPool *pool = argument;
+    int next;
+    while ((next = atomic_fetch_add(&pool->nextJob, 1)) < pool->jobCount)
+    {
+        pool->task(&pool->jobs[next]);
+    }
+    return NULL;
+}
+
+// Parses one recording and keeps its rows as gnuplot data, so the CSV file is never read again
+void parseJob(BatchJob *job)
+{
+    WaveformData data;
+    if (loadWaveformCsv(job->path, &data) < 0)
+    {
+        printf("Skipping %s (no waveform data)\n", job->path);
+        return;
+    }
+    if (data.count == 0)
+    {
+        printf("Skipping %s (no waveform data)\n", job->path);
+        freeWaveformData(&data);
+        return;
+    }
+
+    snprintf(job->title, sizeof(job->title), "%s", data.title);
+    job->lineColor = ledLineColor(data.title, job->path);
+    job->firstMillis = data.timestampsNs[0] / 1e6;
+    job->lastMillis = data.timestampsNs[data.count - 1] / 1e6;
+
+    job->plotData = malloc(data.count * PLOT_ROW_LENGTH + 1);
+    if (job->plotData != NULL)
+    {
+        char *row = job->plotData;
+        for (size_t i = 0; i < data.count; i++)
+        {
+            row += sprintf(row, "%lld.%06lld %d\n", data.timestampsNs[i] / NANOS_PER_MILLI, data.timestampsNs[i] % NANOS_PER_MILLI, data.states[i]);
+        }
+        job->plotDataLength = row - job->plotData;
+    }
+
+    freeWaveformData(&data);
+}
+
+// Colour of the LED a recording is from, the same as the single plot uses: the LED named in the title
+// ("Frequency of Red LED is: ..."), or else the start of the file name (red_waveform_data_003.csv)
+const char *ledLineColor(const char *title, const char *path)
+{
+    if (containsWord(title, "red"))
+    {
+        return "red";
+    }
+    if (containsWord(title, "green"))
+    {
+        return "dark-green";
+    }
+
+    const char *name = strrchr(path, '/');
+    name = name != NULL ? name + 1 : path;
+    if (strncasecmp(name, "red", 3) == 0)
+    {
+        return "red";
+    }
+    if (strncasecmp(name, "green", 5) == 0)
+    {
+        return "dark-green";
+    }
+    return OTHER_LED_COLOR;
+}
+
+// TRUE if word appears in text on its own (ignoring case), so "red" does not match "Measured"
+int containsWord(const char *text, const char *word)
+{
+    size_t length = strlen(word);
+    for (const char *start = text; *start != '\0'; start++)
+    {
+        if ((start == text || !isalpha((unsigned char)start[-1])) && strncasecmp(start, word, length) == 0 && !isalpha((unsigned char)start[length]))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Path of the grid image: inside argument if it is a directory, or else next to the file it names
+void gridImagePath(const char *argument, char *gridPath, size_t size)
+{
+    struct stat status;
+    if (stat(argument, &status) == 0 && S_ISDIR(status.st_mode))
+    {
+        snprintf(gridPath, size, "%s/%s", argument, GRID_IMAGE);
+        return;
+    }
+
+    const char *name = strrchr(argument, '/');
+    if (name == NULL)
+    {
+        snprintf(gridPath, size, "%s", GRID_IMAGE);
+        return;
+    }
+    snprintf(gridPath, size, "%.*s/%s", (int)(name - argument), argument, GRID_IMAGE);
+}
+
+// Copies text for use inside a single quoted gnuplot string, where a quote is written as two quotes
+void quoteForGnuplot(const char *text, char *quoted, size_t size)
+{
+    size_t length = 0;
+    for (; *text != '\0' && length + 2 < size; text++)
+    {
+        if (*text == '\'')
+        {
+            quoted[length++] = '\'';
+        }
+        quoted[length++] = *text;
+    }
+    quoted[length] = '\0';
+}
+
+// Sends the axis settings shared by every plot
+void writeAxes(FILE *gnuplotPipe, double minMillis, double maxMillis)
+{
+    fprintf(gnuplotPipe, "set termoption noenhanced\n"); // Titles are printed as they are
+    fprintf(gnuplotPipe, "set xlabel 'Time (ms)'\n");
+    fprintf(gnuplotPipe, "set ylabel 'High and Low State'\n");
+    fprintf(gnuplotPipe, "set yrange [-1:2]\n");
+    fprintf(gnuplotPipe, "set ytics -1,1,2\n");
+    fprintf(gnuplotPipe, "set xrange [%f:%f]\n", minMillis, maxMillis);
+}
+
+// Renders one recording next to its CSV file (name.csv becomes name.png)
+void renderJob(BatchJob *job)
+{
+    if (job->plotData == NULL)
+    {
+        return;
+    }
+
+    char imagePath[sizeof(job->path) + 4];
+    snprintf(imagePath, sizeof(imagePath), "%s", job->path);
+    char *extension = strrchr(imagePath, '.');
+    strcpy(extension != NULL ? extension : imagePath + strlen(imagePath), ".png");
+
+    // Titles and paths go inside single quotes, so any quote in them has to be doubled
+    char quotedPath[2 * sizeof(imagePath)];
+    char quotedTitle[2 * sizeof(job->title)];
+    quoteForGnuplot(imagePath, quotedPath, sizeof(quotedPath));
+    quoteForGnuplot(job->title, quotedTitle, sizeof(quotedTitle));
+
+    FILE *gnuplotPipe = popen("gnuplot", "w");
+    if (gnuplotPipe == NULL)
+    {
+        printf("Error: Could not open Gnuplot pipe.\n");
+        return;
+    }
+
+    fprintf(gnuplotPipe, "set terminal png size 1200,600\n");
+    fprintf(gnuplotPipe, "set output '%s'\n", quotedPath);
+    writeAxes(gnuplotPipe, job->minMillis, job->maxMillis);
+    fprintf(gnuplotPipe, "plot '-' using 1:2 with steps title '(%s)' linecolor '%s'\n", quotedTitle, job->lineColor);
+    fwrite(job->plotData, 1, job->plotDataLength, gnuplotPipe);
+    fprintf(gnuplotPipe, "e\n");
+    fprintf(gnuplotPipe, "exit\n");
+    pclose(gnuplotPipe);
+
+    printf("Written %s\n", imagePath);
+}
+
+// Renders every recording into one grid image with the same axes
+void renderGrid(BatchJob jobs[], int jobCount, double minMillis, double maxMillis, const char *gridPath)
+{
+    int plotted = 0;
+    for (int i = 0; i < jobCount; i++)
+    {
+        plotted += jobs[i].plotData != NULL;
+    }
+
+    // As square as possible, filling rows first
+    int columns = 1;
+    while (columns * columns < plotted)
+    {
+        columns++;
+    }
+    int rows = (plotted + columns - 1) / columns;
+
+    FILE *gnuplotPipe = popen("gnuplot", "w");
+    if (gnuplotPipe == NULL)
+    {
+        printf("Error: Could not open Gnuplot pipe.\n");
+        return;
+    }
+
+    fprintf(gnuplotPipe, "set terminal png size %d,%d\n", GRID_CELL_WIDTH * columns, GRID_CELL_HEIGHT * rows);
+    char quotedPath[2 * sizeof(jobs[0].path)];
+    quoteForGnuplot(gridPath, quotedPath, sizeof(quotedPath));
+    fprintf(gnuplotPipe, "set output '%s'\n", quotedPath);
+    writeAxes(gnuplotPipe, minMillis, maxMillis);
+    fprintf(gnuplotPipe, "set multiplot layout %d,%d\n", rows, columns);
+    for (int i = 0; i < jobCount; i++)
+    {
+        if (jobs[i].plotData != NULL)
+        {
+            char quotedTitle[2 * sizeof(jobs[i].title)];
+            quoteForGnuplot(jobs[i].title, quotedTitle, sizeof(quotedTitle));
+            fprintf(gnuplotPipe, "plot '-' using 1:2 with steps title '(%s)' linecolor '%s'\n", quotedTitle, jobs[i].lineColor);
+            fwrite(jobs[i].plotData, 1, jobs[i].plotDataLength, gnuplotPipe);
+            fprintf(gnuplotPipe, "e\n");
+        }
+    }
+    fprintf(gnuplotPipe, "unset multiplot\n");
+    fprintf(gnuplotPipe, "exit\n");
+    pclose(gnuplotPipe);
+
+    printf("Written %s (%d x %d)\n", gridPath, rows, columns);
+}
@@ -0,0 +1,330 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -o EdgeCapture EdgeCapture.c GpioHal.c -lwiringPi -lpthread
+Step 3: ./EdgeCapture [seconds] [gpio pin...]
+        e.g. ./EdgeCapture 10 14 15   (captures GPIO14 and GPIO15 for 10 seconds, which are the defaults)
+
+To check for dropped edges without a Raspberry Pi, build with the simulated backend and let its edge source drive
+every pin (here at 50kHz). The edges it made are printed before the summary and must match the edges captured:
+gcc -O2 -DHAL_SIMULATED -o EdgeCapture EdgeCapture.c GpioHal.c -lpthread
+HAL_SIM_EDGE_HZ=50000 ./EdgeCapture 2 14 15
+
+=== WHAT IT DOES ===
+Registers an edge interrupt on every monitor pin and records the edges that are actually observed on the wire,
+instead of the commanded states that NewStudent.c writes to its CSV files.
+
+Each interrupt handler reads the level of its pin, timestamps the edge with the monotonic clock (nanoseconds) and
+pushes it into a preallocated ring for that pin. A writer thread drains the rings into one CSV file per pin using the same
+layout as writeWaveformFile() in NewStudent.c, with the timestamp in milliseconds to 6 decimal places so no
+precision is lost. If a ring ever fills up the edge is dropped and counted, and the drops are reported at the end.
+wiringPi cannot detach its interrupt threads, so when the capture ends the handlers are closed off first and only
+then are the rings drained for the last time. Edges that still arrive after that are counted as after the capture.
+
+=== GPIO PIN CONNECTION ===
+GPIO14 to Student GPIO15
+GPIO15 to Student GPIO14
+GROUND
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "GpioHal.h" // GPIO and interrupt backend (wiringPi unless chosen otherwise at compile time)
+#include "WaveformCsv.h"
+
+// Definitions
+#define MAX_CAPTURE_PINS 4        // Maximum number of pins captured at once (one interrupt handler each)
+#define RING_SIZE 65536           // Edges each ring can hold before edges are dropped (must be a power of 2)
+#define DRAIN_INTERVAL_US 10000   // How often the writer thread empties the rings
+#define DEFAULT_DURATION 10       // Capture duration in seconds if none is given
+#define TIMESTAMP_START 10000     // Start of timestamp, same as NewStudent.c
+#define WRITE_BUFFER_SIZE 65536   // stdio buffer of each CSV file
+
+// One observed edge
+typedef struct
+{
+    unsigned long long timestampNs; // Monotonic time of the interrupt
+    int state;                      // Level of the pin after the edge
+} CapturedEdge;
+
+// Single producer (the interrupt handler) / single consumer (the writer thread) ring of one pin
+typedef struct
+{
+    int pin;                    // GPIO number
+    CapturedEdge *edges;        // RING_SIZE preallocated edges
+    atomic_ulong head;          // Written by the interrupt handler only
+    atomic_ulong tail;          // Written by the writer thread only
+    atomic_ulong dropped;       // Edges lost because the ring was full
+    atomic_ulong afterStop;     // Edges that arrived once the capture had stopped
+    unsigned long written;      // Edges written to the CSV file
+    unsigned long long minPulseNs; // Shortest time between two edges
+    unsigned long long lastNs;  // Time of the previous edge written
+    FILE *file;                 // Output CSV file
+} EdgeRing;
+
+// Function Prototypes
+unsigned long long monotonicNanos();
+void recordEdge(EdgeRing *ring);
+void onEdge0();
+void onEdge1();
+void onEdge2();
+void onEdge3();
+void stopInterrupts();
+void *runWriter(void *argument);
+int drainRings();
+void stopCapture(int signal);
+
+// Capture state
+EdgeRing rings[MAX_CAPTURE_PINS];
+int pinCount = 0;
+unsigned long long captureStartNs;
+volatile sig_atomic_t capturing = 1;
+atomic_int acceptingEdges = 1;  // Cleared by stopInterrupts() before the last drain
+atomic_int handlersRunning = 0; // Interrupt handlers inside recordEdge() right now
+
+// One interrupt handler per pin, since halPinISR() handlers take no arguments
+void (*const edgeHandlers[MAX_CAPTURE_PINS])() = {onEdge0, onEdge1, onEdge2, onEdge3};
+
+int main(int argc, char *argv[])
+{
+    int duration = argc > 1 ? atoi(argv[1]) : DEFAULT_DURATION;
+    int pins[MAX_CAPTURE_PINS] = {14, 15};
+    pinCount = 2;
+
+    // Pins given on the command line replace the default monitor pins
+    if (argc > 2)
+    {
+        pinCount = 0;
+        for (int i = 2; i < argc && pinCount < MAX_CAPTURE_PINS; i++)
+        {
+            pins[pinCount++] = atoi(argv[i]);
+        }
+    }
+
+    if (duration <= 0)
+    {
+        printf("Error: Capture duration must be a positive number of seconds.\n");
+        return 1;
+    }
+
+    if (halSetup() < 0)
+    {
+        printf("Error: Could not set up the GPIO pins.\n");
+        return 1;
+    }
+    signal(SIGINT, stopCapture); // Ctrl+C ends the capture early but still writes everything captured so far
+
+    // Preallocating every ring and opening every file before the first interrupt can fire
+    for (int i = 0; i < pinCount; i++)
+    {
+        EdgeRing *ring = &rings[i];
+        char fileName[64];
+        snprintf(fileName, sizeof(fileName), "gpio%d_capture_waveform_data.csv", pins[i]);
+
+        ring->pin = pins[i];
+        ring->edges = calloc(RING_SIZE, sizeof(CapturedEdge)); // calloc touches the pages now rather than in the interrupt path
+        ring->minPulseNs = ~0ULL;
+        ring->file = fopen(fileName, "w");
+        if (ring->edges == NULL || ring->file == NULL)
+        {
+            printf("Error: Could not prepare capture of GPIO%d.\n", pins[i]);
+            return 1;
+        }
+        setvbuf(ring->file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+        fprintf(ring->file, "Captured edges of GPIO%d\n\n", pins[i]);
+        fprintf(ring->file, "The timestamp in Millisecond | The state of GPIO%d\n", pins[i]);
+        halPinMode(pins[i], INPUT);
+    }
+
+    pthread_t writerThread;
+    captureStartNs = monotonicNanos();
+    if (pthread_create(&writerThread, NULL, runWriter, NULL) != 0)
+    {
+        printf("Error: Could not start the writer thread.\n");
+        return 1;
+    }
+
+    // Registering the interrupts last, so every edge lands in a ready ring
+    for (int i = 0; i < pinCount; i++)
+    {
+        if (halPinISR(rings[i].pin, edgeHandlers[i]) < 0)
+        {
+            printf("Error: Could not register an interrupt on GPIO%d.\n", rings[i].pin);
+            capturing = 0;
+        }
+    }
+
+    printf("\nCapturing edges for %d seconds (Ctrl+C to stop)...\n", duration);
+    for (int elapsed = 0; elapsed < duration * 10 && capturing; elapsed++)
+    {
+        usleep(100000);
+    }
+
+    // Shutting the backend down first stops the simulated edge source, so its count covers every edge the writer drains.
+    // The wiringPi interrupt threads keep running, so the handlers are closed off before the last drain
+    halShutdown();
+    stopInterrupts();
+    capturing = 0;
+    pthread_join(writerThread, NULL);
+
+    // Reporting what was captured, including any losses
+    printf("\n===== CAPTURE SUMMARY =====\n\n");
+    int lossFree = 1;
+    for (int i = 0; i < pinCount; i++)
+    {
+        EdgeRing *ring = &rings[i];
+        unsigned long dropped = atomic_load(&ring->dropped);
+        unsigned long afterStop = atomic_load(&ring->afterStop);
+        lossFree = lossFree && dropped == 0;
+
+        printf("GPIO%d\n", ring->pin);
+        printf("  - Edges captured: %lu\n", ring->written);
+        printf("  - Edges dropped: %lu\n", dropped);
+        if (afterStop > 0)
+        {
+            printf("  - Edges after the capture stopped (not recorded): %lu\n", afterStop);
+        }
+        if (ring->written > 1)
+        {
+            printf("  - Shortest pulse: %.3fus\n", ring->minPulseNs / 1000.0);
+        }
+        fclose(ring->file);
+        free(ring->edges);
+    }
+    printf("\n%s\n\n", lossFree ? "No edges were dropped." : "WARNING: Edges were dropped, the CSV files are incomplete.");
+
+    return lossFree ? 0 : 2;
+}
+
+// Current time of the monotonic clock in nanoseconds
+unsigned long long monotonicNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Interrupt path: read the level as close to the edge as possible, timestamp it, then push it into the ring of its pin
+void recordEdge(EdgeRing *ring)
+{
+    int state = halDigitalRead(ring->pin);
+    unsigned long long timestampNs = monotonicNanos();
+
+    // Announcing the handler before checking the flag, so stopInterrupts() either sees it running or it sees the flag
+    atomic_fetch_add(&handlersRunning, 1);
+    if (!atomic_load(&acceptingEdges))
+    {
+        atomic_store_explicit(&ring->afterStop, atomic_load_explicit(&ring->afterStop, memory_order_relaxed) + 1, memory_order_relaxed);
+        atomic_fetch_sub(&handlersRunning, 1);
+        return;
+    }
+
+    unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= RING_SIZE)
+    {
+        atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1, memory_order_relaxed);
+        atomic_fetch_sub(&handlersRunning, 1);
+        return;
+    }
+
+    CapturedEdge *edge = &ring->edges[head & (RING_SIZE - 1)];
+    edge->timestampNs = timestampNs;
+    edge->state = state;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release); // Publish the edge to the writer thread
+    atomic_fetch_sub(&handlersRunning, 1);
+}
+
+// Stops the handlers from pushing edges and waits for any handler still pushing one, so the last drain sees every edge
+void stopInterrupts()
+{
+    atomic_store(&acceptingEdges, 0);
+    while (atomic_load(&handlersRunning) > 0)
+    {
+        sched_yield();
+    }
+}
+
+void onEdge0()
+{
+    recordEdge(&rings[0]);
+}
+
+void onEdge1()
+{
+    recordEdge(&rings[1]);
+}
+
+void onEdge2()
+{
+    recordEdge(&rings[2]);
+}
+
+void onEdge3()
+{
+    recordEdge(&rings[3]);
+}
+
+// Writer thread: empties the rings every DRAIN_INTERVAL_US until the capture stops, then one last time
+void *runWriter(void *argument)
+{
+    (void)argument;
+    while (capturing)
+    {
+        if (drainRings() == 0)
+        {
+            usleep(DRAIN_INTERVAL_US);
+        }
+    }
+    drainRings();
+    return NULL;
+}
+
+// Writes every edge waiting in the rings to the CSV files. Returns the number of edges written
+int drainRings()
+{
+    int total = 0;
+
+    for (int i = 0; i < pinCount; i++)
+    {
+        EdgeRing *ring = &rings[i];
+        unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        for (; tail != head; tail++)
+        {
+            CapturedEdge *edge = &ring->edges[tail & (RING_SIZE - 1)];
+            unsigned long long offsetNs = edge->timestampNs - captureStartNs;
+
+            if (ring->written > 0 && edge->timestampNs - ring->lastNs < ring->minPulseNs)
+            {
+                ring->minPulseNs = edge->timestampNs - ring->lastNs;
+            }
+            ring->lastNs = edge->timestampNs;
+
+            fprintf(ring->file, WAVEFORM_ROW_FORMAT_PRECISE, TIMESTAMP_START + (long)(offsetNs / NANOS_PER_MILLI), (long)(offsetNs % NANOS_PER_MILLI), edge->state);
+            ring->written++;
+            total++;
+        }
+
+        atomic_store_explicit(&ring->tail, tail, memory_order_release); // Hand the slots back to the interrupt handler
+    }
+
+    return total;
+}
+
+// Ctrl+C handler
+void stopCapture(int signal)
+{
+    (void)signal;
+    capturing = 0;
+}
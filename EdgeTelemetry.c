@@ -0,0 +1,296 @@
+/*
+=== UART EDGE TELEMETRY ===
+See EdgeTelemetry.h for the frame layout and how edges get from the blink loop to the serial port.
+*/
+
+#include "EdgeTelemetry.h"
+#include "GpioHal.h"
+#include "BlinkTrace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define TELEMETRY_MAX_EDGE_BYTES 11 // Channel byte plus the longest varint
+
+int telemetryRunning = 0;
+TelemetryEntry telemetryRing[TELEMETRY_RING_SIZE];
+atomic_ulong telemetryHead = 0;
+atomic_ulong telemetryTail = 0;
+atomic_ulong telemetryDropped = 0;
+sem_t telemetryWake;
+
+static int telemetryPort = -1;
+static pthread_t senderThread;
+static atomic_int senderStopping = 0;
+static char channelNames[TELEMETRY_MAX_CHANNELS][TELEMETRY_NAME_LENGTH];
+static unsigned long long telemetryStartNs = 0;
+static unsigned char frameSequence = 0;
+
+// Totals reported by stopEdgeTelemetry()
+static unsigned long edgesSent = 0;
+static unsigned long framesSent = 0;
+static unsigned long long bytesSent = 0;
+static unsigned long droppedReported = 0;
+static atomic_ulong channelsDropped = 0; // Run announcements lost because the ring was full
+static unsigned long writeErrors = 0;
+
+// Appends value as a LEB128 varint and returns the number of bytes written
+static size_t putVarint(unsigned char *buffer, unsigned long long value)
+{
+    size_t length = 0;
+    while (value >= 0x80)
+    {
+        buffer[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (unsigned char)value;
+    return length;
+}
+
+// Microseconds since startEdgeTelemetry()
+static unsigned long long telemetryMicros(unsigned long long timeNs)
+{
+    return timeNs > telemetryStartNs ? (timeNs - telemetryStartNs) / 1000ULL : 0;
+}
+
+// Wraps a payload into a frame and writes it to the port, retrying short writes
+static void sendFrame(int type, const unsigned char *payload, size_t length)
+{
+    unsigned char frame[TELEMETRY_HEADER_BYTES + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_BYTES];
+    frame[0] = TELEMETRY_SYNC_FIRST;
+    frame[1] = TELEMETRY_SYNC_SECOND;
+    frame[2] = (unsigned char)type;
+    frame[3] = frameSequence++;
+    frame[4] = (unsigned char)length;
+    if (length > 0)
+    {
+        memcpy(frame + TELEMETRY_HEADER_BYTES, payload, length);
+    }
+
+    unsigned short crc = telemetryCrc16(frame + 2, TELEMETRY_HEADER_BYTES - 2 + length);
+    frame[TELEMETRY_HEADER_BYTES + length] = (unsigned char)(crc & 0xFF);
+    frame[TELEMETRY_HEADER_BYTES + length + 1] = (unsigned char)(crc >> 8);
+
+    size_t total = TELEMETRY_HEADER_BYTES + length + TELEMETRY_CRC_BYTES;
+    size_t written = 0;
+    TRACE_BEGIN(serialWrite);
+    while (written < total)
+    {
+        ssize_t result = write(telemetryPort, frame + written, total - written);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            writeErrors++;
+            break;
+        }
+        written += (size_t)result;
+    }
+    TRACE_END(serialWrite, "telemetry_write");
+
+    framesSent++;
+    bytesSent += written;
+}
+
+// Sends the settings of a new run on a channel
+static void sendChannelFrame(const TelemetryEntry *entry)
+{
+    unsigned char payload[TELEMETRY_MAX_PAYLOAD];
+    size_t length = 0;
+    length += putVarint(payload + length, entry->channel);
+    length += putVarint(payload + length, entry->frequency);
+    length += putVarint(payload + length, entry->brightness);
+    length += putVarint(payload + length, telemetryMicros(entry->timeNs));
+
+    size_t nameLength = strnlen(channelNames[entry->channel], TELEMETRY_NAME_LENGTH - 1);
+    memcpy(payload + length, channelNames[entry->channel], nameLength);
+    sendFrame(TELEMETRY_FRAME_CHANNEL, payload, length + nameLength);
+}
+
+// Sends an EDGES frame without edges, only to carry edges dropped since the last frame
+static void sendDroppedFrame()
+{
+    unsigned long dropped = atomic_load_explicit(&telemetryDropped, memory_order_relaxed);
+    if (dropped == droppedReported)
+    {
+        return;
+    }
+
+    unsigned char payload[TELEMETRY_MAX_PAYLOAD];
+    size_t length = 0;
+    length += putVarint(payload + length, dropped - droppedReported);
+    length += putVarint(payload + length, telemetryMicros(halNanos()));
+    droppedReported = dropped;
+    sendFrame(TELEMETRY_FRAME_EDGES, payload, length);
+}
+
+// Drains the ring into frames until stopEdgeTelemetry() is called and the ring is empty
+static void *runSender(void *argument)
+{
+    (void)argument;
+    TRACE_THREAD("telemetry");
+    sendFrame(TELEMETRY_FRAME_START, NULL, 0); // Tells the monitor a new session starts, so nothing before it counts as lost
+
+    int batching = FALSE; // Set once the batch wait is over, until the ring runs empty again
+    while (TRUE)
+    {
+        int stopping = atomic_load(&senderStopping);
+        unsigned long tail = atomic_load_explicit(&telemetryTail, memory_order_relaxed);
+        unsigned long head = atomic_load_explicit(&telemetryHead, memory_order_acquire);
+        if (tail == head)
+        {
+            if (stopping)
+            {
+                break;
+            }
+            batching = FALSE;
+            while (sem_wait(&telemetryWake) < 0 && errno == EINTR)
+            {
+                // Interrupted by a signal, so go back to sleep
+            }
+            continue; // A post can be left over from an entry already sent, so check the ring again
+        }
+        if (!batching && !stopping)
+        {
+            usleep(TELEMETRY_BATCH_US); // Let edges pile up behind the first one so the frame is a full one
+            batching = TRUE;
+            continue;
+        }
+
+        TelemetryEntry *entry = &telemetryRing[tail & (TELEMETRY_RING_SIZE - 1)];
+        if (entry->state == TELEMETRY_CHANNEL_CHANGED)
+        {
+            TelemetryEntry announcement = *entry;
+            atomic_store_explicit(&telemetryTail, tail + 1, memory_order_release);
+            sendChannelFrame(&announcement);
+            continue;
+        }
+
+        unsigned char payload[TELEMETRY_MAX_PAYLOAD];
+        size_t length = 0;
+        unsigned long dropped = atomic_load_explicit(&telemetryDropped, memory_order_relaxed);
+        length += putVarint(payload + length, dropped - droppedReported);
+        droppedReported = dropped;
+
+        unsigned long long previousUs = telemetryMicros(entry->timeNs);
+        length += putVarint(payload + length, previousUs);
+
+        // Pack edges until the frame is full or an announcement comes up
+        while (tail != head && length + TELEMETRY_MAX_EDGE_BYTES <= TELEMETRY_MAX_PAYLOAD)
+        {
+            entry = &telemetryRing[tail & (TELEMETRY_RING_SIZE - 1)];
+            if (entry->state == TELEMETRY_CHANNEL_CHANGED)
+            {
+                break;
+            }
+
+            unsigned long long timeUs = telemetryMicros(entry->timeNs);
+            payload[length++] = (unsigned char)((entry->channel << 1) | entry->state);
+            length += putVarint(payload + length, timeUs > previousUs ? timeUs - previousUs : 0);
+            previousUs = timeUs > previousUs ? timeUs : previousUs;
+            edgesSent++;
+            tail++;
+        }
+
+        // Hand the slots back before the write, which blocks for as long as the line needs
+        atomic_store_explicit(&telemetryTail, tail, memory_order_release);
+        sendFrame(TELEMETRY_FRAME_EDGES, payload, length);
+    }
+
+    sendDroppedFrame(); // Drops after the last batch would otherwise never reach the monitor
+    return NULL;
+}
+
+// Opens the telemetry port and starts the sender thread. Returns 0 on success and -1 on failure
+int startEdgeTelemetry(const char *device, int baud)
+{
+    if (device == NULL || telemetryRunning)
+    {
+        return -1;
+    }
+
+    telemetryPort = halSerialOpen(device, baud);
+    if (telemetryPort < 0)
+    {
+        fprintf(stderr, "Unable to open telemetry port %s\n", device);
+        return -1;
+    }
+
+    atomic_store(&telemetryHead, 0);
+    atomic_store(&telemetryTail, 0);
+    atomic_store(&telemetryDropped, 0);
+    atomic_store(&channelsDropped, 0);
+    atomic_store(&senderStopping, 0);
+    edgesSent = 0;
+    framesSent = 0;
+    bytesSent = 0;
+    droppedReported = 0;
+    writeErrors = 0;
+    frameSequence = 0;
+    telemetryStartNs = halNanos();
+
+    if (sem_init(&telemetryWake, 0, 0) < 0 || pthread_create(&senderThread, NULL, runSender, NULL) != 0)
+    {
+        halSerialClose(telemetryPort);
+        telemetryPort = -1;
+        return -1;
+    }
+
+    telemetryRunning = 1;
+    return 0;
+}
+
+// Announces a new run on a channel. Like an edge, the announcement is dropped and counted if the ring is full,
+// so arming a run never waits on the link
+void telemetryChannel(int channel, const char *name, int frequency, int brightness, unsigned long long startNs)
+{
+    if (!telemetryRunning || channel < 0 || channel >= TELEMETRY_MAX_CHANNELS)
+    {
+        return;
+    }
+
+    // The sender may be copying the name of an earlier announcement, so it is only rewritten when it really changes
+    if (strncmp(channelNames[channel], name, TELEMETRY_NAME_LENGTH - 1) != 0)
+    {
+        snprintf(channelNames[channel], TELEMETRY_NAME_LENGTH, "%s", name);
+    }
+    if (telemetryPush(startNs, channel, TELEMETRY_CHANNEL_CHANGED, frequency, brightness) < 0)
+    {
+        atomic_fetch_add_explicit(&channelsDropped, 1, memory_order_relaxed);
+    }
+}
+
+// Sends whatever is still in the ring, stops the sender thread and prints the totals
+void stopEdgeTelemetry()
+{
+    if (!telemetryRunning)
+    {
+        return;
+    }
+
+    telemetryRunning = 0;
+    atomic_store(&senderStopping, 1);
+    sem_post(&telemetryWake); // The sender may be asleep on the empty ring
+    pthread_join(senderThread, NULL);
+    sem_destroy(&telemetryWake);
+    tcdrain(telemetryPort); // Wait for the last frame to leave the UART before closing it
+    halSerialClose(telemetryPort);
+    telemetryPort = -1;
+
+    printf("Telemetry: %lu edges in %lu frames (%llu bytes), %lu edges dropped", edgesSent, framesSent, bytesSent, atomic_load(&telemetryDropped));
+    if (atomic_load(&channelsDropped) > 0)
+    {
+        printf(", %lu run announcements dropped", atomic_load(&channelsDropped));
+    }
+    if (writeErrors > 0)
+    {
+        printf(", %lu failed writes", writeErrors);
+    }
+    printf("\n");
+}
@@ -0,0 +1,131 @@
+/*
+=== UART EDGE TELEMETRY ===
+Streams every LED edge from the student device to the monitor as compact binary frames while a run is going,
+so results no longer have to be copied over with scp afterwards. Decode the stream with TelemetryMonitor.c.
+
+The blink loop hands each edge to telemetryEdge(), which only pushes it into a preallocated ring (no I/O, no locks,
+one producer thread). A sender thread drains the ring into frames of up to TELEMETRY_MAX_PAYLOAD bytes and writes
+them to the serial port. While the ring is empty the sender sleeps on a semaphore, which the producer posts only
+when it pushes into an empty ring, so an idle link costs no wakeups and a busy one at most one post per batch.
+After that first entry the sender waits TELEMETRY_BATCH_US so slow edges still batch; when edges come in faster than
+the line can carry them, full frames go out back to back at the line rate.
+If the ring fills up because the link cannot keep up, edges (and run announcements) are dropped and counted. The
+edge count travels in the next frame so the monitor knows what is missing, and on shutdown a last frame without
+edges carries any drops that came after the final batch.
+
+Frame layout (numbers in the payload are LEB128 varints: 7 bits per byte, low bits first, top bit set if more follow)
+  0xA5 0x5A  sync
+  type       TELEMETRY_FRAME_START, TELEMETRY_FRAME_EDGES or TELEMETRY_FRAME_CHANNEL
+  sequence   frame number, wrapping at 256 (a gap tells the monitor frames were lost)
+  length     payload bytes
+  payload
+  crc        CRC-16/CCITT of type, sequence, length and payload (2 bytes, low byte first)
+
+  START payload   : none. Sent first by startEdgeTelemetry(); the time base and the sequence start over
+  EDGES payload   : edges dropped since the previous frame, time of the first edge, then for each edge
+                    one byte (channel << 1 | state) and the time since the previous edge (possibly none)
+  CHANNEL payload : channel, frequency in Hz, brightness in %, start time of the run, then the LED name
+
+Times are in microseconds since startEdgeTelemetry(). An edge takes its channel byte plus the varint of the time since
+the previous edge (2 bytes for gaps up to 16ms, 3 bytes up to 2s), and every frame adds 7 bytes of header and CRC.
+NewStudent's two LEDs need a few hundred bytes a second, a small part of the 11,520 bytes/s of 115200 baud.
+
+=== HOW TO USE ===
+gcc -o YourTool YourTool.c EdgeTelemetry.c GpioHal.c -lwiringPi -lpthread
+*/
+
+#ifndef EDGE_TELEMETRY_H
+#define EDGE_TELEMETRY_H
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define TELEMETRY_BAUD 115200     // Line rate of the telemetry link
+#define TELEMETRY_SYNC_FIRST 0xA5 // First sync byte of every frame
+#define TELEMETRY_SYNC_SECOND 0x5A
+#define TELEMETRY_HEADER_BYTES 5  // Sync, type, sequence and length
+#define TELEMETRY_CRC_BYTES 2
+#define TELEMETRY_MAX_PAYLOAD 255 // Largest payload a frame can carry
+#define TELEMETRY_MAX_CHANNELS 128 // Channel numbers have to fit in 7 bits
+#define TELEMETRY_NAME_LENGTH 16  // Maximum length of an LED name (including '\0')
+#define TELEMETRY_RING_SIZE 4096  // Edges waiting for the sender before edges are dropped (must be a power of 2)
+#define TELEMETRY_BATCH_US 20000  // How long the sender waits for more edges after the first one of a batch
+
+// Frame types
+#define TELEMETRY_FRAME_START 1
+#define TELEMETRY_FRAME_EDGES 2
+#define TELEMETRY_FRAME_CHANNEL 3
+
+#define TELEMETRY_CHANNEL_CHANGED 0xFF // State of a ring entry that announces a new run on a channel
+
+// One entry of the ring: an edge, or the announcement of a new run on a channel
+typedef struct
+{
+    unsigned long long timeNs;  // Monotonic time of the edge (or start of the run)
+    unsigned short channel;     // LED number
+    unsigned char state;        // State after the edge, or TELEMETRY_CHANNEL_CHANGED
+    unsigned short frequency;   // Frequency of the new run in Hz (announcements only)
+    unsigned short brightness;  // Brightness of the new run in % (announcements only)
+} TelemetryEntry;
+
+extern int telemetryRunning;
+extern TelemetryEntry telemetryRing[TELEMETRY_RING_SIZE];
+extern atomic_ulong telemetryHead;    // Written by the producer only
+extern atomic_ulong telemetryTail;    // Written by the sender thread only
+extern atomic_ulong telemetryDropped; // Edges lost because the ring was full
+extern sem_t telemetryWake;           // Posted when an entry goes into an empty ring
+
+// Pushes one entry into the ring. Returns 0 on success and -1 if the ring is full
+static inline int telemetryPush(unsigned long long timeNs, int channel, int state, int frequency, int brightness)
+{
+    unsigned long head = atomic_load_explicit(&telemetryHead, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&telemetryTail, memory_order_acquire);
+    if (head - tail >= TELEMETRY_RING_SIZE)
+    {
+        return -1;
+    }
+
+    TelemetryEntry *entry = &telemetryRing[head & (TELEMETRY_RING_SIZE - 1)];
+    entry->timeNs = timeNs;
+    entry->channel = (unsigned short)channel;
+    entry->state = (unsigned char)state;
+    entry->frequency = (unsigned short)frequency;
+    entry->brightness = (unsigned short)brightness;
+    atomic_store_explicit(&telemetryHead, head + 1, memory_order_release); // Publish the entry to the sender thread
+    if (head == tail)
+    {
+        sem_post(&telemetryWake); // The sender may be asleep on the empty ring
+    }
+    return 0;
+}
+
+// Queues one edge for the monitor (does nothing unless telemetry was started). Safe to call from the blink loop
+static inline void telemetryEdge(int channel, int state, unsigned long long timeNs)
+{
+    if (telemetryRunning && telemetryPush(timeNs, channel, state ? 1 : 0, 0, 0) < 0)
+    {
+        atomic_store_explicit(&telemetryDropped, atomic_load_explicit(&telemetryDropped, memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+}
+
+// CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) shared by the sender and the monitor
+static inline unsigned short telemetryCrc16(const unsigned char *data, size_t length)
+{
+    unsigned short crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= (unsigned short)(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (unsigned short)((crc << 1) ^ 0x1021) : (unsigned short)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+int startEdgeTelemetry(const char *device, int baud);
+void telemetryChannel(int channel, const char *name, int frequency, int brightness, unsigned long long startNs);
+void stopEdgeTelemetry();
+
+#endif
@@ -0,0 +1,158 @@
+/*
+=== IN-TREE FFT ===
+See Fft.h for how the transform is laid out.
+*/
+
+#include "Fft.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 4 floats processed together (SSE on x86, NEON on ARM)
+typedef float Float4 __attribute__((vector_size(16)));
+
+// Unaligned load and store of 4 floats
+static inline Float4 load4(const float *p)
+{
+    Float4 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline void store4(float *p, Float4 value)
+{
+    memcpy(p, &value, sizeof(value));
+}
+
+// Prepares the tables for a transform of size points. Returns 0 on success and -1 if size is not a power of 2 or memory ran out
+int createFft(Fft *fft, size_t size)
+{
+    memset(fft, 0, sizeof(*fft));
+    if (size < 2 || (size & (size - 1)) != 0)
+    {
+        return -1;
+    }
+
+    fft->size = size;
+    fft->twiddleRe = malloc(size * sizeof(float));
+    fft->twiddleIm = malloc(size * sizeof(float));
+    fft->reverse = malloc(size * sizeof(unsigned int));
+    if (fft->twiddleRe == NULL || fft->twiddleIm == NULL || fft->reverse == NULL)
+    {
+        destroyFft(fft);
+        return -1;
+    }
+
+    // Twiddles of each stage stored next to each other, so a stage reads them sequentially
+    for (size_t half = 1; half < size; half *= 2)
+    {
+        for (size_t k = 0; k < half; k++)
+        {
+            double angle = -M_PI * k / half;
+            fft->twiddleRe[half + k] = (float)cos(angle);
+            fft->twiddleIm[half + k] = (float)sin(angle);
+        }
+    }
+
+    int bits = 0;
+    while (((size_t)1 << bits) < size)
+    {
+        bits++;
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned int reversed = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        fft->reverse[i] = reversed;
+    }
+
+    return 0;
+}
+
+// Frees the tables made by createFft()
+void destroyFft(Fft *fft)
+{
+    free(fft->twiddleRe);
+    free(fft->twiddleIm);
+    free(fft->reverse);
+    memset(fft, 0, sizeof(*fft));
+}
+
+// Forward transform of re/im in place (no scaling)
+void runFft(const Fft *fft, float *re, float *im)
+{
+    size_t size = fft->size;
+
+    // Putting the input in bit-reversed order
+    for (size_t i = 0; i < size; i++)
+    {
+        size_t j = fft->reverse[i];
+        if (j > i)
+        {
+            float swap = re[i];
+            re[i] = re[j];
+            re[j] = swap;
+            swap = im[i];
+            im[i] = im[j];
+            im[j] = swap;
+        }
+    }
+
+    // The first two stages have fewer than 4 butterflies per group, so they stay scalar
+    for (size_t half = 1; half < size && half < 4; half *= 2)
+    {
+        for (size_t group = 0; group < size; group += 2 * half)
+        {
+            for (size_t k = 0; k < half; k++)
+            {
+                size_t top = group + k;
+                size_t bottom = top + half;
+                float wr = fft->twiddleRe[half + k];
+                float wi = fft->twiddleIm[half + k];
+                float tr = re[bottom] * wr - im[bottom] * wi;
+                float ti = re[bottom] * wi + im[bottom] * wr;
+                re[bottom] = re[top] - tr;
+                im[bottom] = im[top] - ti;
+                re[top] += tr;
+                im[top] += ti;
+            }
+        }
+    }
+
+    // Every later stage runs 4 butterflies at a time
+    for (size_t half = 4; half < size; half *= 2)
+    {
+        const float *twiddleRe = fft->twiddleRe + half;
+        const float *twiddleIm = fft->twiddleIm + half;
+
+        for (size_t group = 0; group < size; group += 2 * half)
+        {
+            float *topRe = re + group;
+            float *topIm = im + group;
+            float *bottomRe = topRe + half;
+            float *bottomIm = topIm + half;
+
+            for (size_t k = 0; k < half; k += 4)
+            {
+                Float4 wr = load4(twiddleRe + k);
+                Float4 wi = load4(twiddleIm + k);
+                Float4 br = load4(bottomRe + k);
+                Float4 bi = load4(bottomIm + k);
+                Float4 ar = load4(topRe + k);
+                Float4 ai = load4(topIm + k);
+
+                Float4 tr = br * wr - bi * wi;
+                Float4 ti = br * wi + bi * wr;
+
+                store4(bottomRe + k, ar - tr);
+                store4(bottomIm + k, ai - ti);
+                store4(topRe + k, ar + tr);
+                store4(topIm + k, ai + ti);
+            }
+        }
+    }
+}
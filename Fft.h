@@ -0,0 +1,31 @@
+/*
+=== IN-TREE FFT ===
+Iterative radix-2 complex FFT on split real/imaginary float arrays.
+
+The butterflies of every stage with at least 4 butterflies per group run 4 at a time on GCC vector types,
+which compile to SSE on x86 and NEON on the Raspberry Pi (build with -O2, and -mfpu=neon on 32-bit Raspberry Pi OS).
+The twiddle factors and bit-reversal table are computed once per size by createFft().
+
+=== HOW TO USE ===
+gcc -O2 -o YourTool YourTool.c Fft.c -lm
+*/
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+
+// Precomputed tables for one transform size
+typedef struct
+{
+    size_t size;           // Number of points (power of 2)
+    float *twiddleRe;      // Twiddles of the stage with half size h are at [h, 2h)
+    float *twiddleIm;
+    unsigned int *reverse; // Bit-reversed index of every point
+} Fft;
+
+int createFft(Fft *fft, size_t size);
+void destroyFft(Fft *fft);
+void runFft(const Fft *fft, float *re, float *im);
+
+#endif
@@ -0,0 +1,266 @@
+/*
+=== GPIO / CLOCK HARDWARE ABSTRACTION ===
+See GpioHal.h for the backends. Only setup, shutdown, the simulated serial port and the simulated
+edge source live here, everything on the hot path is inline in the header.
+*/
+
+#include "GpioHal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(HAL_SIMULATED)
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define HAL_SIM_MAX_EDGE_SOURCES 8 // Pins the simulated edge source can drive at once
+
+// One pin driven by the simulated edge source
+typedef struct
+{
+    int pin;                     // Pin that is toggled
+    void (*handler)(void);       // Interrupt handler registered with halPinISR()
+    unsigned long long periodNs; // Time between two edges
+    unsigned long edges;         // Edges made so far
+    unsigned long long startNs;  // Real time of the first edge
+    pthread_t thread;            // Thread that plays the part of the interrupt
+} EdgeSource;
+
+static EdgeSource edgeSources[HAL_SIM_MAX_EDGE_SOURCES];
+static int edgeSourceCount = 0;
+static volatile int edgeSourcesRunning = 0;
+
+// Simulated hardware state
+atomic_ullong halSimNowNs = 0;
+atomic_ullong halSimStallAtNs = 0; // Virtual time from which the next sleep is stalled
+atomic_ullong halSimStallNs = 0;   // How late that sleep wakes up (0 if no stall is set)
+HalCall halSimCalls[HAL_SIM_MAX_CALLS];
+unsigned long halSimCallCount = 0;
+unsigned int halSimLevels = 0;
+
+// Names of the recorded call kinds, in HAL_CALL_ order
+static const char *callNames[] = {"pinMode", "digitalWrite", "writePins", "pwmCreate", "pwmWrite", "pwmStop", "serialOpen", "serialWrite", "serialClose", "pinISR"};
+
+// Real time of the monotonic clock, which paces the edge source (the virtual clock only moves when the program reads it)
+static unsigned long long realNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Toggles one pin every periodNs against a fixed schedule and calls its handler, like a wiringPi interrupt thread.
+// If the thread wakes up late, the edges it owes follow straight after each other, so the average rate holds
+static void *runEdgeSource(void *argument)
+{
+    EdgeSource *source = argument;
+    unsigned long long nextNs = realNanos();
+    source->startNs = nextNs;
+
+    while (edgeSourcesRunning)
+    {
+        nextNs += source->periodNs;
+        struct timespec wakeTime = {(time_t)(nextNs / 1000000000ULL), (long)(nextNs % 1000000000ULL)};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTime, NULL) == EINTR)
+        {
+            // Interrupted by a signal, so go back to sleep
+        }
+
+        __atomic_fetch_xor(&halSimLevels, 1u << source->pin, __ATOMIC_RELEASE);
+        source->handler();
+        source->edges++;
+    }
+    return NULL;
+}
+
+// Makes the first sleep that ends at or after atNs (virtual time) wake up lengthNs late, to test how late edges are handled
+void halSimStall(unsigned long long atNs, unsigned long long lengthNs)
+{
+    atomic_store(&halSimStallAtNs, atNs);
+    atomic_store(&halSimStallNs, lengthNs);
+}
+
+// Registers an interrupt handler. With HAL_SIM_EDGE_HZ set, a simulated edge source starts toggling the pin at that rate
+int halPinISR(int pin, void (*handler)(void))
+{
+    halSimRecord(HAL_CALL_PIN_ISR, pin, 0);
+
+    const char *rate = getenv("HAL_SIM_EDGE_HZ");
+    if (rate == NULL || atol(rate) <= 0)
+    {
+        return 0; // Nothing drives the pin, so the handler is never called
+    }
+    if (edgeSourceCount >= HAL_SIM_MAX_EDGE_SOURCES)
+    {
+        return -1;
+    }
+
+    EdgeSource *source = &edgeSources[edgeSourceCount];
+    source->pin = pin;
+    source->handler = handler;
+    source->periodNs = 1000000000ULL / (unsigned long long)atol(rate);
+    source->edges = 0;
+    edgeSourcesRunning = 1;
+    if (pthread_create(&source->thread, NULL, runEdgeSource, source) != 0)
+    {
+        return -1;
+    }
+    edgeSourceCount++;
+    return 0;
+}
+
+// Stops every edge source and prints what it made, so a capture can be checked against it.
+// The rate actually reached is printed too, as one thread cannot keep up with very high rates
+static void stopEdgeSources()
+{
+    edgeSourcesRunning = 0;
+    for (int i = 0; i < edgeSourceCount; i++)
+    {
+        EdgeSource *source = &edgeSources[i];
+        pthread_join(source->thread, NULL);
+        double seconds = (realNanos() - source->startNs) / 1e9;
+        printf("Simulated edge source: %lu edges on GPIO%d (%.0f edges/s, target %lluHz)\n", source->edges, source->pin, seconds > 0 ? source->edges / seconds : 0.0, 1000000000ULL / source->periodNs);
+    }
+    edgeSourceCount = 0;
+}
+
+int halSetup()
+{
+    atomic_store(&halSimNowNs, 0);
+    atomic_store(&halSimStallNs, 0);
+    halSimCallCount = 0;
+    halSimLevels = 0;
+    return 0;
+}
+
+// Stops the simulated edge sources and writes the recorded calls to the file named by HAL_SIM_LOG (if set)
+void halShutdown()
+{
+    stopEdgeSources();
+
+    const char *path = getenv("HAL_SIM_LOG");
+    if (path == NULL || path[0] == '\0')
+    {
+        return;
+    }
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return;
+    }
+
+    unsigned long recorded = halSimCallCount < HAL_SIM_MAX_CALLS ? halSimCallCount : HAL_SIM_MAX_CALLS;
+    for (unsigned long i = 0; i < recorded; i++)
+    {
+        HalCall *call = &halSimCalls[i];
+        if (call->type == HAL_CALL_WRITE_PINS)
+        {
+            fprintf(file, "%llu %s set=0x%08x clear=0x%08x\n", call->timeNs, callNames[call->type], (unsigned int)call->pin, (unsigned int)call->value);
+        }
+        else
+        {
+            fprintf(file, "%llu %s %d %d\n", call->timeNs, callNames[call->type], call->pin, call->value);
+        }
+    }
+    if (halSimCallCount > recorded)
+    {
+        fprintf(file, "# %lu further calls were not recorded\n", halSimCallCount - recorded);
+    }
+    fclose(file);
+}
+
+// Opens any tty (e.g. one end of a pty pair) as a raw serial port at the given baud rate
+int halSerialOpen(const char *device, int baud)
+{
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    halSimRecord(HAL_CALL_SERIAL_OPEN, fd, baud);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    speed_t speed = baud >= 115200 ? B115200 : baud >= 57600 ? B57600 : baud >= 38400 ? B38400 : baud >= 19200 ? B19200 : B9600;
+    struct termios options;
+    tcgetattr(fd, &options);
+    cfmakeraw(&options);
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    options.c_cc[VMIN] = 0;
+    options.c_cc[VTIME] = 100; // Ten second read timeout, same as wiringSerial
+    tcsetattr(fd, TCSANOW, &options);
+    return fd;
+}
+
+void halSerialPuts(int fd, const char *text)
+{
+    halSimRecord(HAL_CALL_SERIAL_WRITE, fd, (int)strlen(text));
+    if (write(fd, text, strlen(text)) < 0)
+    {
+        perror("halSerialPuts");
+    }
+}
+
+void halSerialClose(int fd)
+{
+    halSimRecord(HAL_CALL_SERIAL_CLOSE, fd, 0);
+    close(fd);
+}
+
+#elif defined(HAL_RAW_REGISTERS)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// GPIO registers mapped from /dev/gpiomem
+volatile unsigned int *halGpio = NULL;
+
+int halSetup()
+{
+    wiringPiSetupGpio(); // Still needed by softPwm and wiringSerial
+
+    int fd = open("/dev/gpiomem", O_RDWR | O_SYNC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error opening /dev/gpiomem\n");
+        return -1;
+    }
+
+    void *mapping = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Error mapping /dev/gpiomem\n");
+        return -1;
+    }
+
+    halGpio = mapping;
+    return 0;
+}
+
+void halShutdown()
+{
+    if (halGpio != NULL)
+    {
+        munmap((void *)halGpio, 4096);
+        halGpio = NULL;
+    }
+}
+
+#else
+
+int halSetup()
+{
+    return wiringPiSetupGpio();
+}
+
+void halShutdown()
+{
+}
+
+#endif
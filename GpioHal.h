@@ -0,0 +1,332 @@
+/*
+=== GPIO / CLOCK HARDWARE ABSTRACTION ===
+Every GPIO, PWM, clock and serial call made by NewStudent.c and student.c goes through the hal functions below.
+The backend is chosen when compiling, and every hot-path function is a static inline wrapper, so each call
+compiles straight down to the backend call (no function pointers, no extra call on the toggle path).
+
+  (default)            wiringPi, exactly as before
+                       gcc -O2 -o NewStudent NewStudent.c GpioHal.c ... -lwiringPi
+  -DHAL_RAW_REGISTERS  Pin modes and writes go straight to the GPFSEL/GPSET0/GPCLR0 registers in /dev/gpiomem,
+                       so a coalesced write of several pins is one register store. softPwm and serial still use wiringPi
+                       halReadPins() reads the level of every pin with one GPLEV0 load (raw and simulated backends only)
+                       gcc -O2 -DHAL_RAW_REGISTERS -o NewStudent NewStudent.c GpioHal.c ... -lwiringPi
+  -DHAL_SIMULATED      No hardware at all, builds on any Linux machine. Time is virtual: sleeping jumps straight to
+                       the deadline, so a 10 second blink finishes instantly. Every call is recorded with its virtual
+                       timestamp for assertions, and written to the file named by HAL_SIM_LOG on halShutdown()
+                       halSimStall() makes one sleep wake up late, as if the thread was not scheduled in time
+                       gcc -O2 -DHAL_SIMULATED -o NewStudent NewStudent.c GpioHal.c ... -lpthread
+                       Pins given to halPinISR() are driven by a simulated edge source when HAL_SIM_EDGE_HZ is set:
+                       one thread per pin toggles the pin at that rate in real time and calls the handler, like the
+                       interrupt threads of wiringPi. halShutdown() stops them and prints how many edges each made
+*/
+
+#ifndef GPIO_HAL_H
+#define GPIO_HAL_H
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <time.h>
+
+int halSetup();
+void halShutdown();
+
+#if defined(HAL_SIMULATED)
+
+// =========================== SIMULATED BACKEND ===========================
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define HAL_SIM_MAX_CALLS 1048576 // Calls recorded before further calls are only counted
+#define HAL_SIM_TICK_NS 1000      // Virtual time that passes on every clock read, so polling loops still move forward
+
+// Kinds of recorded call
+#define HAL_CALL_PIN_MODE 0
+#define HAL_CALL_DIGITAL_WRITE 1
+#define HAL_CALL_WRITE_PINS 2
+#define HAL_CALL_PWM_CREATE 3
+#define HAL_CALL_PWM_WRITE 4
+#define HAL_CALL_PWM_STOP 5
+#define HAL_CALL_SERIAL_OPEN 6
+#define HAL_CALL_SERIAL_WRITE 7
+#define HAL_CALL_SERIAL_CLOSE 8
+#define HAL_CALL_PIN_ISR 9
+
+// One recorded call
+typedef struct
+{
+    unsigned long long timeNs; // Virtual time of the call
+    int type;                  // HAL_CALL_ kind
+    int pin;                   // Pin (or set mask for HAL_CALL_WRITE_PINS, descriptor for serial calls)
+    int value;                 // Value written (or clear mask for HAL_CALL_WRITE_PINS)
+} HalCall;
+
+extern atomic_ullong halSimNowNs; // Virtual clock, advanced by every thread that reads the clock or sleeps
+extern atomic_ullong halSimStallAtNs;
+extern atomic_ullong halSimStallNs;
+extern HalCall halSimCalls[HAL_SIM_MAX_CALLS];
+extern unsigned long halSimCallCount;
+extern unsigned int halSimLevels;
+
+// Records one call at the current virtual time (the slot is claimed atomically, as the menu and the engine thread both make calls)
+static inline void halSimRecord(int type, int pin, int value)
+{
+    unsigned long index = __atomic_fetch_add(&halSimCallCount, 1, __ATOMIC_RELAXED);
+    if (index < HAL_SIM_MAX_CALLS)
+    {
+        HalCall *call = &halSimCalls[index];
+        call->timeNs = atomic_load_explicit(&halSimNowNs, memory_order_relaxed);
+        call->type = type;
+        call->pin = pin;
+        call->value = value;
+    }
+}
+
+static inline void halPinMode(int pin, int mode)
+{
+    halSimRecord(HAL_CALL_PIN_MODE, pin, mode);
+}
+
+static inline void halDigitalWrite(int pin, int value)
+{
+    if (value)
+    {
+        __atomic_fetch_or(&halSimLevels, 1u << pin, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        __atomic_fetch_and(&halSimLevels, ~(1u << pin), __ATOMIC_RELEASE);
+    }
+    halSimRecord(HAL_CALL_DIGITAL_WRITE, pin, value);
+}
+
+static inline void halWritePins(unsigned int setMask, unsigned int clearMask)
+{
+    __atomic_fetch_or(&halSimLevels, setMask, __ATOMIC_RELEASE);
+    __atomic_fetch_and(&halSimLevels, ~clearMask, __ATOMIC_RELEASE);
+    halSimRecord(HAL_CALL_WRITE_PINS, (int)setMask, (int)clearMask);
+}
+
+static inline int halDigitalRead(int pin)
+{
+    return (__atomic_load_n(&halSimLevels, __ATOMIC_ACQUIRE) >> pin) & 1;
+}
+
+// Levels of GPIO0 to GPIO31 at once, one bit per pin
+static inline unsigned int halReadPins()
+{
+    return __atomic_load_n(&halSimLevels, __ATOMIC_ACQUIRE);
+}
+
+int halPinISR(int pin, void (*handler)(void));
+void halSimStall(unsigned long long atNs, unsigned long long lengthNs);
+
+static inline int halPwmCreate(int pin, int initialValue, int range)
+{
+    (void)range;
+    halSimRecord(HAL_CALL_PWM_CREATE, pin, initialValue);
+    return 0;
+}
+
+static inline void halPwmWrite(int pin, int value)
+{
+    halSimRecord(HAL_CALL_PWM_WRITE, pin, value);
+}
+
+static inline void halPwmStop(int pin)
+{
+    halSimRecord(HAL_CALL_PWM_STOP, pin, 0);
+}
+
+static inline unsigned long long halNanos()
+{
+    return atomic_fetch_add_explicit(&halSimNowNs, HAL_SIM_TICK_NS, memory_order_relaxed) + HAL_SIM_TICK_NS;
+}
+
+// Moves the virtual clock forward to deadline, unless another thread has already moved it further
+static inline int halSleepUntilNanos(unsigned long long deadline)
+{
+    // The first sleep that ends at or after a stall set with halSimStall() wakes up that much late
+    if (atomic_load_explicit(&halSimStallNs, memory_order_relaxed) != 0 && deadline >= atomic_load_explicit(&halSimStallAtNs, memory_order_relaxed))
+    {
+        deadline += atomic_exchange(&halSimStallNs, 0);
+    }
+
+    unsigned long long now = atomic_load_explicit(&halSimNowNs, memory_order_relaxed);
+    while (deadline > now && !atomic_compare_exchange_weak_explicit(&halSimNowNs, &now, deadline, memory_order_relaxed, memory_order_relaxed))
+    {
+        // now was reloaded by the failed exchange, so try again against the newer time
+    }
+    return 0;
+}
+
+int halSerialOpen(const char *device, int baud);
+void halSerialPuts(int fd, const char *text);
+void halSerialClose(int fd);
+
+#else
+
+// ====================== WIRINGPI AND RAW REGISTER BACKENDS ======================
+
+#include <wiringPi.h>
+#include <softPwm.h>
+#include <wiringSerial.h>
+
+// Current time of the monotonic clock in nanoseconds
+static inline unsigned long long halNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Sleeps until the monotonic clock reaches deadline (returns straight away if it already has).
+// Returns 0, or the error of clock_nanosleep() if it failed for any reason other than a signal
+static inline int halSleepUntilNanos(unsigned long long deadline)
+{
+    struct timespec wakeTime;
+    wakeTime.tv_sec = deadline / 1000000000ULL;
+    wakeTime.tv_nsec = deadline % 1000000000ULL;
+    int result;
+    while ((result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTime, NULL)) == EINTR)
+    {
+        // Interrupted by a signal, so go back to sleep
+    }
+    return result;
+}
+
+static inline int halPwmCreate(int pin, int initialValue, int range)
+{
+    return softPwmCreate(pin, initialValue, range);
+}
+
+static inline void halPwmWrite(int pin, int value)
+{
+    softPwmWrite(pin, value);
+}
+
+static inline void halPwmStop(int pin)
+{
+    softPwmStop(pin);
+}
+
+static inline int halSerialOpen(const char *device, int baud)
+{
+    return serialOpen(device, baud);
+}
+
+static inline void halSerialPuts(int fd, const char *text)
+{
+    serialPuts(fd, text);
+}
+
+static inline void halSerialClose(int fd)
+{
+    serialClose(fd);
+}
+
+// Calls handler on every edge of pin, from an interrupt thread of wiringPi. Returns 0 on success and -1 on failure
+static inline int halPinISR(int pin, void (*handler)(void))
+{
+    return wiringPiISR(pin, INT_EDGE_BOTH, handler);
+}
+
+#if defined(HAL_RAW_REGISTERS)
+
+// Register word offsets in /dev/gpiomem
+#define HAL_GPFSEL0 0
+#define HAL_GPSET0 7
+#define HAL_GPCLR0 10
+#define HAL_GPLEV0 13
+
+extern volatile unsigned int *halGpio;
+
+static inline void halPinMode(int pin, int mode)
+{
+    volatile unsigned int *select = halGpio + HAL_GPFSEL0 + pin / 10;
+    int shift = (pin % 10) * 3;
+    *select = (*select & ~(7u << shift)) | ((mode == OUTPUT ? 1u : 0u) << shift);
+}
+
+static inline void halDigitalWrite(int pin, int value)
+{
+    halGpio[value ? HAL_GPSET0 : HAL_GPCLR0] = 1u << pin;
+}
+
+// Sets and clears any number of pins (GPIO0 to GPIO31) with one store to each register
+static inline void halWritePins(unsigned int setMask, unsigned int clearMask)
+{
+    if (setMask)
+    {
+        halGpio[HAL_GPSET0] = setMask;
+    }
+    if (clearMask)
+    {
+        halGpio[HAL_GPCLR0] = clearMask;
+    }
+}
+
+static inline int halDigitalRead(int pin)
+{
+    return (halGpio[HAL_GPLEV0] >> pin) & 1;
+}
+
+// Levels of GPIO0 to GPIO31 with one read of GPLEV0, one bit per pin
+static inline unsigned int halReadPins()
+{
+    return halGpio[HAL_GPLEV0];
+}
+
+#else
+
+static inline void halPinMode(int pin, int mode)
+{
+    pinMode(pin, mode);
+}
+
+static inline void halDigitalWrite(int pin, int value)
+{
+    digitalWrite(pin, value);
+}
+
+// wiringPi has no multi-pin write for BCM pin numbers, so the pins are written one after another
+// (only the pins in the masks are visited, so writing two LEDs costs two digitalWrite calls and nothing more)
+static inline void halWritePins(unsigned int setMask, unsigned int clearMask)
+{
+    unsigned int pins = setMask | clearMask;
+    while (pins)
+    {
+        int pin = __builtin_ctz(pins);
+        pins &= pins - 1;
+        digitalWrite(pin, setMask & (1u << pin) ? HIGH : LOW);
+    }
+}
+
+static inline int halDigitalRead(int pin)
+{
+    return digitalRead(pin);
+}
+
+#endif
+
+#endif
+
+// Milliseconds since an arbitrary point, for the existing millis() style polling loops
+static inline unsigned long halMillis()
+{
+    return (unsigned long)(halNanos() / 1000000ULL);
+}
+
+// Sleeps for the given number of milliseconds
+static inline void halDelay(unsigned int milliseconds)
+{
+    halSleepUntilNanos(halNanos() + milliseconds * 1000000ULL);
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -o HalBench HalBench.c GpioHal.c -lwiringPi -lpthread
+        (add -DHAL_RAW_REGISTERS to time the raw register backend, or build with -DHAL_SIMULATED and -lpthread only
+        to time the simulated backend off the Pi)
+Step 3: sudo ./HalBench [iterations]
+
+Times the calls the blink loop makes for every edge, once through GpioHal and once as the direct wiringPi calls
+NewStudent.c made before GpioHal, and prints the nanoseconds per iteration of both:
+  toggle     one pin written HIGH and then LOW (halDigitalWrite / digitalWrite)
+  led update PWM value and pin state of both LEDs, as writeLedOutputs() does on a tick with an edge on each
+             (halPwmWrite and halWritePins / softPwmWrite and digitalWrite)
+  clock read one read of the clock (halNanos / millis)
+With the default backend every hal call inlines to the wiringPi call, so both columns should agree within noise.
+The simulated backend has no wiringPi to compare against, so only its own column is printed.
+The LEDs on GPIO13 and GPIO27 flicker while it runs.
+*/
+
+#include "GpioHal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Definitions
+#define GREEN_PIN 13                // Same pins as NewStudent.c
+#define RED_PIN 27
+#define DEFAULT_ITERATIONS 10000000 // Iterations of every loop
+#define REPEATS 3                   // Best of this many runs is reported
+
+// Function Prototypes
+double nowSeconds();
+double bestNanosPerIteration(void (*loop)(long), long iterations);
+void halToggle(long iterations);
+void halLedUpdate(long iterations);
+void halClockRead(long iterations);
+#if !defined(HAL_SIMULATED)
+void directToggle(long iterations);
+void directLedUpdate(long iterations);
+void directClockRead(long iterations);
+#endif
+
+volatile unsigned long long clockSink; // Keeps the clock reads from being optimised away
+
+int main(int argc, char *argv[])
+{
+    long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0 || halSetup() < 0)
+    {
+        printf("Error: Could not set up the GPIO backend.\n");
+        return 1;
+    }
+    halPinMode(GREEN_PIN, OUTPUT);
+    halPinMode(RED_PIN, OUTPUT);
+
+    printf("%ld iterations, best of %d\n\n", iterations, REPEATS);
+    printf("%-12s %12s %12s\n", "", "GpioHal", "direct");
+
+#if defined(HAL_SIMULATED)
+    printf("%-12s %10.1fns %12s\n", "toggle", bestNanosPerIteration(halToggle, iterations), "-");
+    printf("%-12s %10.1fns %12s\n", "led update", bestNanosPerIteration(halLedUpdate, iterations), "-");
+    printf("%-12s %10.1fns %12s\n", "clock read", bestNanosPerIteration(halClockRead, iterations), "-");
+#else
+    printf("%-12s %10.1fns %10.1fns\n", "toggle", bestNanosPerIteration(halToggle, iterations), bestNanosPerIteration(directToggle, iterations));
+    printf("%-12s %10.1fns %10.1fns\n", "led update", bestNanosPerIteration(halLedUpdate, iterations), bestNanosPerIteration(directLedUpdate, iterations));
+    printf("%-12s %10.1fns %10.1fns\n", "clock read", bestNanosPerIteration(halClockRead, iterations), bestNanosPerIteration(directClockRead, iterations));
+#endif
+
+    halWritePins(0, (1u << GREEN_PIN) | (1u << RED_PIN));
+    halPinMode(GREEN_PIN, INPUT);
+    halPinMode(RED_PIN, INPUT);
+    halShutdown();
+    return 0;
+}
+
+// Current time in seconds (always the real clock, also with the simulated backend)
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Runs a loop REPEATS times and returns its fastest time per iteration in nanoseconds
+double bestNanosPerIteration(void (*loop)(long), long iterations)
+{
+    double best = 0;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = nowSeconds();
+        loop(iterations);
+        double elapsed = nowSeconds() - start;
+        best = r == 0 || elapsed < best ? elapsed : best;
+    }
+    return best * 1e9 / iterations;
+}
+
+void halToggle(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        halDigitalWrite(GREEN_PIN, HIGH);
+        halDigitalWrite(GREEN_PIN, LOW);
+    }
+}
+
+// Both LEDs change on every iteration, one turning on while the other turns off
+void halLedUpdate(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        int greenOn = i & 1;
+        halPwmWrite(GREEN_PIN, greenOn ? 50 : 0);
+        halPwmWrite(RED_PIN, greenOn ? 0 : 50);
+        halWritePins(1u << (greenOn ? GREEN_PIN : RED_PIN), 1u << (greenOn ? RED_PIN : GREEN_PIN));
+    }
+}
+
+void halClockRead(long iterations)
+{
+    unsigned long long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        sum += halNanos();
+    }
+    clockSink = sum;
+}
+
+#if !defined(HAL_SIMULATED)
+
+void directToggle(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        digitalWrite(GREEN_PIN, HIGH);
+        digitalWrite(GREEN_PIN, LOW);
+    }
+}
+
+void directLedUpdate(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        int greenOn = i & 1;
+        softPwmWrite(GREEN_PIN, greenOn ? 50 : 0);
+        softPwmWrite(RED_PIN, greenOn ? 0 : 50);
+        digitalWrite(GREEN_PIN, greenOn ? HIGH : LOW);
+        digitalWrite(RED_PIN, greenOn ? LOW : HIGH);
+    }
+}
+
+void directClockRead(long iterations)
+{
+    unsigned long long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        sum += millis();
+    }
+    clockSink = sum;
+}
+
+#endif
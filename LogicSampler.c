@@ -0,0 +1,395 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -DHAL_RAW_REGISTERS -o LogicSampler LogicSampler.c GpioHal.c -lwiringPi
+Step 3: sudo ./LogicSampler [seconds] [gpio pin...]
+        e.g. sudo ./LogicSampler 2 13 27   (samples the two LED pins for 2 seconds, which are the defaults)
+
+It reads the pins through GpioHal.h with halReadPins(), so it needs the raw register backend on the Pi. To try it on a
+plain Linux machine without a Raspberry Pi, build it with the simulated backend instead:
+        gcc -O2 -DHAL_SIMULATED -o LogicSampler LogicSampler.c GpioHal.c -lpthread
+
+=== WHAT IT DOES ===
+A logic analyser for signals that are too fast or too noisy for EdgeCapture.c. The GPIO level register (GPLEV0)
+is read at a fixed SAMPLE_RATE_HZ and every read is stored as one 32-bit word (one bit per pin) in a preallocated
+buffer sized for the whole run (rate x duration). Each read waits for its own deadline (start + sample x period),
+so sample n was taken at start + n periods and that is its timestamp. Samples taken more than one period after
+their deadline (e.g. when the sampler was preempted) are counted; if there are any the run is reported as inaccurate.
+A run that needs more than MAX_SAMPLE_WORDS samples is rejected before sampling starts.
+
+Afterwards the buffer is compared with itself shifted by one sample (XOR) several words at a time with SIMD
+instructions, so the long stretches where nothing changes are skipped quickly. Every change on a pin of interest
+becomes an edge in gpio<pin>_sampled_waveform_data.csv, in the same layout as writeWaveformFile() in NewStudent.c.
+
+At 2MHz this resolves both the blink edges and the 100us steps of the softPwm carrier started in setupProgram().
+
+With the simulated backend a test signal is written to the simulated pins from the clock right before every read:
+a 10Hz 50% blink gated by a 100Hz 30% softPwm-style carrier on GPIO13 and a 7Hz 25% blink on GPIO27. It needs no
+second thread, so it also gives accurate timing on a single core machine.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "GpioHal.h" // Register access (raw register or simulated backend)
+
+#if !defined(HAL_RAW_REGISTERS) && !defined(HAL_SIMULATED)
+#error "LogicSampler reads every pin in one register load: build it with -DHAL_RAW_REGISTERS (or -DHAL_SIMULATED)"
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "WaveformCsv.h"
+
+// Definitions
+#define MAX_SAMPLE_PINS 8              // Maximum number of pins written out
+#define SAMPLE_RATE_HZ 2000000        // Samples taken per second
+#define MAX_SAMPLE_WORDS (64 << 20)    // Largest sample buffer (256MB), which is 33 seconds at SAMPLE_RATE_HZ
+#define DEFAULT_DURATION 2             // Sampling duration in seconds if none is given
+#define TIMESTAMP_START 10000          // Start of timestamp, same as NewStudent.c
+#define WRITE_BUFFER_SIZE 65536        // stdio buffer of each CSV file
+
+// Timing of a sampling run
+typedef struct
+{
+    unsigned long long startNs;       // Deadline of the first sample
+    unsigned long long endNs;         // Time after the last sample
+    size_t lateSamples;               // Samples taken a whole period or more after their deadline
+    unsigned long long maxLatenessNs; // Worst time between a deadline and its sample
+} SampleClock;
+
+// Positions where at least one pin of interest changed between two samples
+typedef struct
+{
+    size_t *indices;   // Sample index right after the change
+    uint32_t *changed; // Bits that changed
+    size_t count;
+    size_t capacity;
+} ChangeList;
+
+// Function Prototypes
+unsigned long long monotonicNanos();
+void sampleLevels(uint32_t *samples, size_t count, SampleClock *clock);
+void addChange(ChangeList *changes, size_t index, uint32_t changed);
+void extractChanges(const uint32_t *samples, size_t count, uint32_t pinMask, ChangeList *changes);
+unsigned long long sampleTime(size_t index, const SampleClock *clock);
+int writePinWaveform(int pin, const uint32_t *samples, size_t count, const ChangeList *changes, const SampleClock *clock);
+
+int main(int argc, char *argv[])
+{
+    int duration = argc > 1 ? atoi(argv[1]) : DEFAULT_DURATION;
+    int pins[MAX_SAMPLE_PINS] = {13, 27};
+    int pinCount = 2;
+
+    // Pins given on the command line replace the default LED pins
+    if (argc > 2)
+    {
+        pinCount = 0;
+        for (int i = 2; i < argc && pinCount < MAX_SAMPLE_PINS; i++)
+        {
+            pins[pinCount++] = atoi(argv[i]);
+        }
+    }
+
+    uint32_t pinMask = 0;
+    for (int i = 0; i < pinCount; i++)
+    {
+        if (pins[i] < 0 || pins[i] > 31)
+        {
+            printf("Error: GPIO%d is not in the GPLEV0 register (GPIO0 to GPIO31).\n", pins[i]);
+            return 1;
+        }
+        pinMask |= 1u << pins[i];
+    }
+    if (duration <= 0)
+    {
+        printf("Error: Sampling duration must be a positive number of seconds.\n");
+        return 1;
+    }
+
+    // Sizing the buffer for the whole run, so sampling never stops early
+    size_t count = (size_t)duration * SAMPLE_RATE_HZ;
+    if (count > MAX_SAMPLE_WORDS)
+    {
+        printf("Error: %d seconds at %.1f MHz needs %zu samples, more than the %d the buffer allows. Sample for at most %d seconds.\n", duration, SAMPLE_RATE_HZ / 1e6, count, MAX_SAMPLE_WORDS, MAX_SAMPLE_WORDS / SAMPLE_RATE_HZ);
+        return 1;
+    }
+
+    // Preallocating the sample buffer and touching every page before sampling starts
+    uint32_t *samples = malloc(count * sizeof(uint32_t));
+    if (samples == NULL)
+    {
+        printf("Error: Could not allocate %zuMB for the sample buffer.\n", count * sizeof(uint32_t) >> 20);
+        return 1;
+    }
+    memset(samples, 0, count * sizeof(uint32_t));
+
+    if (halSetup() < 0)
+    {
+        printf("Error: Could not set up the GPIO backend.\n");
+        free(samples);
+        return 1;
+    }
+
+    printf("\nSampling for %d seconds at %.1f MHz...\n", duration, SAMPLE_RATE_HZ / 1e6);
+    SampleClock clock;
+    sampleLevels(samples, count, &clock);
+    halShutdown();
+
+    double seconds = (clock.endNs - clock.startNs) / 1e9;
+    printf("Collected %zu samples in %.3fs (%.3f MHz measured)\n", count, seconds, count / seconds / 1e6);
+    if (clock.lateSamples > 0)
+    {
+        printf("WARNING: %zu samples were taken a sample period or more late (worst %.1fus), so edge times are off by up to that much.\n", clock.lateSamples, clock.maxLatenessNs / 1000.0);
+    }
+
+    // Finding every change on the pins of interest
+    unsigned long long extractStart = monotonicNanos();
+    ChangeList changes = {0};
+    extractChanges(samples, count, pinMask, &changes);
+    printf("Found %zu changes in %.1fms\n\n", changes.count, (monotonicNanos() - extractStart) / 1e6);
+
+    for (int i = 0; i < pinCount; i++)
+    {
+        writePinWaveform(pins[i], samples, count, &changes, &clock);
+    }
+
+    free(changes.indices);
+    free(changes.changed);
+    free(samples);
+    return clock.lateSamples > 0 ? 2 : 0;
+}
+
+// Current time of the monotonic clock in nanoseconds
+unsigned long long monotonicNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#if defined(HAL_SIMULATED)
+
+// Time the test signal started
+static unsigned long long simulatorStart;
+
+// Level of a square wave with the given frequency and duty cycle (percent) at time nanos
+static int squareWave(unsigned long long nanos, unsigned long long hertz, unsigned long long duty)
+{
+    unsigned long long period = 1000000000ULL / hertz;
+    return (nanos % period) < period * duty / 100;
+}
+
+// Writes the test signal to the simulated pins, only when it changes so the call log stays short
+static inline void driveTestSignal()
+{
+    static uint32_t current;
+    unsigned long long nanos = monotonicNanos() - simulatorStart;
+    uint32_t word = 0;
+    word |= (uint32_t)(squareWave(nanos, 10, 50) && squareWave(nanos, 100, 30)) << 13; // Blink gated by the PWM carrier
+    word |= (uint32_t)squareWave(nanos, 7, 25) << 27;
+    if (word != current)
+    {
+        halWritePins(word & ~current, current & ~word);
+        current = word;
+    }
+}
+
+#endif
+
+// One read of every pin level (GPLEV0)
+static inline uint32_t readLevels()
+{
+#if defined(HAL_SIMULATED)
+    driveTestSignal();
+#endif
+    return halReadPins();
+}
+
+// Reads the level register into every one of count samples, each at its own deadline (start + index periods)
+// The deadlines never move, so a late sample does not delay the ones after it; it is only counted in clock
+void sampleLevels(uint32_t *samples, size_t count, SampleClock *clock)
+{
+    memset(clock, 0, sizeof(*clock));
+    clock->startNs = monotonicNanos() + 1000000; // A millisecond to settle before the first deadline
+#if defined(HAL_SIMULATED)
+    simulatorStart = clock->startNs;
+#endif
+
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned long long deadline = sampleTime(i, clock);
+        unsigned long long now;
+        while ((now = monotonicNanos()) < deadline)
+        {
+            // Spinning, as the period is far shorter than any sleep
+        }
+        samples[i] = readLevels();
+
+        unsigned long long lateness = now - deadline;
+        if (lateness > clock->maxLatenessNs)
+        {
+            clock->maxLatenessNs = lateness;
+        }
+        if (lateness * SAMPLE_RATE_HZ >= 1000000000ULL)
+        {
+            clock->lateSamples++;
+        }
+    }
+
+    clock->endNs = monotonicNanos();
+}
+
+// Appends one change to the list, growing it when needed
+void addChange(ChangeList *changes, size_t index, uint32_t changed)
+{
+    if (changes->count == changes->capacity)
+    {
+        changes->capacity = changes->capacity > 0 ? changes->capacity * 2 : 4096;
+        changes->indices = realloc(changes->indices, changes->capacity * sizeof(size_t));
+        changes->changed = realloc(changes->changed, changes->capacity * sizeof(uint32_t));
+        if (changes->indices == NULL || changes->changed == NULL)
+        {
+            printf("Error: Out of memory while extracting edges.\n");
+            exit(1);
+        }
+    }
+
+    changes->indices[changes->count] = index;
+    changes->changed[changes->count] = changed;
+    changes->count++;
+}
+
+// Finds every sample where a pin in pinMask differs from the sample before it
+void extractChanges(const uint32_t *samples, size_t count, uint32_t pinMask, ChangeList *changes)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // 8 samples per iteration: XOR each sample with the next one and skip the block if no pin of interest changed
+    const __m128i mask = _mm_set1_epi32(pinMask);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 9 <= count; i += 8)
+    {
+        __m128i low = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(samples + i)), _mm_loadu_si128((const __m128i *)(samples + i + 1)));
+        __m128i high = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(samples + i + 4)), _mm_loadu_si128((const __m128i *)(samples + i + 5)));
+        __m128i any = _mm_and_si128(_mm_or_si128(low, high), mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, zero)) == 0xFFFF)
+        {
+            continue;
+        }
+
+        for (int k = 0; k < 8; k++)
+        {
+            uint32_t changed = (samples[i + k] ^ samples[i + k + 1]) & pinMask;
+            if (changed)
+            {
+                addChange(changes, i + k + 1, changed);
+            }
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint32x4_t mask = vdupq_n_u32(pinMask);
+    for (; i + 9 <= count; i += 8)
+    {
+        uint32x4_t low = veorq_u32(vld1q_u32(samples + i), vld1q_u32(samples + i + 1));
+        uint32x4_t high = veorq_u32(vld1q_u32(samples + i + 4), vld1q_u32(samples + i + 5));
+        uint32x4_t any = vandq_u32(vorrq_u32(low, high), mask);
+        uint32x2_t folded = vorr_u32(vget_low_u32(any), vget_high_u32(any));
+        if ((vget_lane_u32(folded, 0) | vget_lane_u32(folded, 1)) == 0)
+        {
+            continue;
+        }
+
+        for (int k = 0; k < 8; k++)
+        {
+            uint32_t changed = (samples[i + k] ^ samples[i + k + 1]) & pinMask;
+            if (changed)
+            {
+                addChange(changes, i + k + 1, changed);
+            }
+        }
+    }
+#endif
+
+    // Scalar tail (and the whole buffer when no SIMD is available)
+    for (; i + 1 < count; i++)
+    {
+        uint32_t changed = (samples[i] ^ samples[i + 1]) & pinMask;
+        if (changed)
+        {
+            addChange(changes, i + 1, changed);
+        }
+    }
+}
+
+// Deadline of sample index, which is also its timestamp
+unsigned long long sampleTime(size_t index, const SampleClock *clock)
+{
+    return clock->startNs + (unsigned long long)index * 1000000000ULL / SAMPLE_RATE_HZ;
+}
+
+// Writes the edges of one pin as a waveform CSV and prints a short summary of the signal
+int writePinWaveform(int pin, const uint32_t *samples, size_t count, const ChangeList *changes, const SampleClock *clock)
+{
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "gpio%d_sampled_waveform_data.csv", pin);
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL)
+    {
+        printf("Error: Could not write %s.\n", fileName);
+        return -1;
+    }
+    setvbuf(file, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+    uint32_t bit = 1u << pin;
+    unsigned long long start = clock->startNs;
+    unsigned long long end = sampleTime(count - 1, clock);
+    unsigned long long highNanos = 0;
+    unsigned long long lastNanos = start;
+    unsigned long rising = 0;
+    int state = (samples[0] & bit) != 0;
+
+    fprintf(file, "Sampled edges of GPIO%d\n\n", pin);
+    fprintf(file, "The timestamp in Millisecond | The state of GPIO%d\n", pin);
+    fprintf(file, WAVEFORM_ROW_FORMAT_PRECISE, (long)TIMESTAMP_START, 0L, state); // State at the first sample
+
+    for (size_t c = 0; c < changes->count; c++)
+    {
+        if (!(changes->changed[c] & bit))
+        {
+            continue;
+        }
+
+        unsigned long long nanos = sampleTime(changes->indices[c], clock);
+        unsigned long long offset = nanos - start;
+        if (state)
+        {
+            highNanos += nanos - lastNanos;
+        }
+        state = !state;
+        rising += state;
+        lastNanos = nanos;
+
+        fprintf(file, WAVEFORM_ROW_FORMAT_PRECISE, TIMESTAMP_START + (long)(offset / NANOS_PER_MILLI), (long)(offset % NANOS_PER_MILLI), state);
+    }
+    if (state)
+    {
+        highNanos += end - lastNanos;
+    }
+    fclose(file);
+
+    double seconds = (end - start) / 1e9;
+    printf("GPIO%d\n", pin);
+    printf("  - Rising edges: %lu (%.1f Hz average)\n", rising, rising / seconds);
+    printf("  - High: %.1f%% of the time\n", 100.0 * highNanos / (end - start));
+    printf("  - Written to %s\n", fileName);
+    return 0;
+}
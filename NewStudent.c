@@ -1,9 +1,57 @@
 /*
 === HOW TO RUN ===
 Step 1: cd into C file location
-Step 2: gcc -o NewStudent NewStudent.c -lwiringPi
+Step 2: gcc -o NewStudent NewStudent.c GpioHal.c BlinkMetrics.c BlinkTrace.c RunArena.c EdgeTelemetry.c -lwiringPi -lpthread
 Step 3: ./NewStudent
 
+To build and run without a Raspberry Pi (virtual time, every GPIO call recorded), use the simulated backend:
+gcc -DHAL_SIMULATED -o NewStudent NewStudent.c GpioHal.c BlinkMetrics.c BlinkTrace.c RunArena.c EdgeTelemetry.c -lpthread
+HAL_SIM_LOG=calls.txt ./NewStudent
+BlinkEngineTest.c checks the blink schedule against the recorded calls, and HalBench.c times the hot-path calls.
+
+=== RUNTIME METRICS ===
+While the program runs, blink_metrics.txt is refreshed once a second with edge counts, lateness,
+file write statistics and CPU time. View it with: watch -n 1 cat blink_metrics.txt
+
+=== RUN MEMORY ===
+Before a run starts, the exact number of edges of every LED is worked out from its frequency, brightness and the
+blink duration, and every record, histogram and output buffer of the run is taken from one preallocated mapping.
+If the mapping would not fit in the available memory the run is rejected before any LED turns on. Nothing is
+allocated and nothing is written to disk while the LEDs blink: the waveform files are written once the run is over.
+
+=== EXPERIMENT QUEUE ===
+Blink runs are queued and executed one after another by an engine thread, so the menu stays usable while LEDs blink:
+[5] shows the running and queued runs and the drift report of the last finished run, [6] cancels the running run and
+drops the queued ones. Each run is prepared (timing tables, buffers, waveform files, PWM) when it is queued, and a run
+queued behind another starts on the scheduled end of that run. The time the engine needs between the two is in the report.
+A writer thread writes every finished run to its own numbered files (e.g. green_waveform_data_003.csv), and
+green_waveform_data.csv / red_waveform_data.csv are pointed at the newest run.
+
+=== IDLE PWM ===
+The softPwm threads are only started when a blink or "Turn on" needs them. Once the main menu has waited
+PWM_IDLE_TIMEOUT_S seconds without input, they are stopped and the pins hold their level with a plain GPIO write
+(an LED left at part brightness keeps its PWM). On exit, the time from start to the first menu and the wakeups
+per second while idle at the menu (with and without PWM running) are printed.
+
+=== EDGE TELEMETRY ===
+Run with EDGE_TELEMETRY_DEVICE=/dev/ttyAMA0 ./NewStudent to stream every edge to the monitor over the UART at 115200 baud
+while the LEDs blink. The monitor decodes the stream into the usual waveform files with TelemetryMonitor.c, so nothing
+has to be copied over after the run. Edges only go into a ring in the blink loop; the serial writes happen on their own thread.
+
+=== LED OUTPUTS ===
+Edges of several LEDs due on the same tick are collected and written in one pass. Only a build with -DHAL_RAW_REGISTERS
+changes all their pins with a single GPSET0/GPCLR0 store; the default wiringPi build still calls digitalWrite once per
+pin, and every backend updates the softPwm value of each LED separately.
+
+=== LATE EDGES ===
+Run with BLINK_LATE_POLICY=catch-up, skip or stretch ./NewStudent to choose what happens to an edge that is more than
+LATE_THRESHOLD_US behind its deadline (catch up is the default). Every queued run keeps the policy it was queued with,
+and the drift report names it.
+
+=== TRACE CAPTURE ===
+Build with -DBLINK_TRACE and run with BLINK_TRACE_FILE=trace.json ./NewStudent
+On exit, trace.json holds a Chrome trace-event timeline of scheduler wakeups, GPIO writes, PWM updates and file flushes.
+
 === PRE-REQUISITES ===
 Install wiringPi: https://learn.sparkfun.com/tutorials/raspberry-gpio/c-wiringpi-setup
 softPwm is installed with wiringPi
@@ -23,12 +71,26 @@ GROUND
 */
 
 // Libraries to import
-#include <wiringPi.h>
-#include <softPwm.h>
+#include "GpioHal.h" // GPIO, PWM and clock backend (wiringPi unless chosen otherwise at compile time)
 #include <signal.h>
 #include <stdio.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BlinkMetrics.h" // Engine counters and gauges
+#include "BlinkTrace.h"   // Opt-in timeline capture
+#include "EdgeTelemetry.h" // Live edge stream to the monitor
+#include "RunArena.h"     // Preallocated run buffers
+#include "WaveformCsv.h"  // Shared waveform row format
 
 // Definitions
 #define CONFIRM 1        // Defines the confirm value used in menus
@@ -48,17 +110,100 @@ GROUND
 #define TIMESTAMP_START 10000 // Start of timestamp
 #define BLINK_DURATION 10     // Duration of in seconds
 
+// Late Edge Policies (what to do with an edge that is more than LATE_THRESHOLD_US behind its deadline)
+#define LATE_CATCH_UP 0 // Emit every missed edge straight away until the schedule is caught up
+#define LATE_SKIP 1     // Drop the missed edges and resume at the most recent slot
+#define LATE_STRETCH 2  // Push the rest of the schedule back by the lateness
+
+#define LATE_EDGE_POLICY LATE_CATCH_UP // Policy used unless BLINK_LATE_POLICY names another one
+#define LATE_THRESHOLD_US 1000         // Lateness allowed before an edge counts as late (one scheduler tick)
+
+#define ARM_DELAY_US 20000 // Time between arming the LEDs and the shared start epoch, so every LED starts on the same instant
+
+#define LATENESS_BUCKET_US 10     // Width of one bucket of the lateness histogram
+#define LATENESS_BUCKETS 1000     // Buckets of the lateness histogram (the last one also counts everything later than 10ms)
+#define WAVEFORM_HEADER_BYTES 256 // Space for the header lines of a waveform file
+
+#define PWM_IDLE_TIMEOUT_S 30 // Seconds the main menu waits without input before the PWM threads are stopped
+
+#define EXPERIMENT_QUEUE_LENGTH 8 // Runs that can be in progress at once (queued, blinking or waiting for the writer)
+#define CANCEL_CHECK_US 50000     // Longest the engine sleeps before checking for a cancel
+#define RUN_REPORT_BYTES 4096     // Space for the drift report of one run
+#define WAVEFORM_PATH_LENGTH 64   // Space for the name of a numbered waveform file
+
 // Program States
 #define TURN_OFF 0
 #define TURN_ON 1
 #define BLINK 2
 #define BLINK_ALL 3
 #define EXIT 4
+#define STATUS 5
+#define CANCEL 6
 
-// File to store waveform data
+// File to store waveform data (each points at the numbered file of the newest run)
 #define WAVEFORM_FILE_GREEN "green_waveform_data.csv"
 #define WAVEFORM_FILE_RED "red_waveform_data.csv"
 
+// File the metrics snapshot is written to once a second
+#define METRICS_FILE "blink_metrics.txt"
+
+// One emitted edge, kept in the run arena until the run is over
+typedef struct
+{
+    unsigned long long timeNanos; // Time the edge actually happened, after the start epoch
+    int state;                    // State the LED was changed to
+} EdgeRecord;
+
+// Every buffer of one run, all taken from a single arena before the LEDs are armed
+typedef struct
+{
+    RunArena arena;
+    unsigned long long *offsets[NUMBER_OF_LEDS]; // Time of every edge of each LED after its start (the timing table)
+    EdgeRecord *records[NUMBER_OF_LEDS];       // Edges of each LED in the order they were emitted
+    unsigned long capacity[NUMBER_OF_LEDS];    // Edges in the schedule of each LED
+    unsigned long recorded[NUMBER_OF_LEDS];    // Edges recorded so far
+    unsigned long *histograms[NUMBER_OF_LEDS]; // Lateness histogram of each LED
+    char *outputs[NUMBER_OF_LEDS];             // Text of each waveform file, formatted once the run is over
+    size_t outputSizes[NUMBER_OF_LEDS];        // Size of each output buffer
+} RunBuffers;
+
+// Results of one run, filled in by the engine thread and turned into the drift report by the writer thread
+typedef struct
+{
+    int cancelled;                                       // Flag to check if the run was cancelled before its last edge
+    int sleepError;                                      // Error that stopped the run while waiting for an edge (0 if none)
+    long long transitionNanos;                           // Engine time from the last edge of the run before to arming this one (-1 if not queued behind one)
+    long long gapNanos;                                  // Start of this run after the scheduled end of the run before (-1 if not queued behind one)
+    unsigned long long startOffsetNanos[NUMBER_OF_LEDS]; // Phase offset of each LED after the start epoch
+    unsigned long edgesEmitted[NUMBER_OF_LEDS];          // Edges emitted
+    unsigned long lateEdges[NUMBER_OF_LEDS];             // Edges emitted later than LATE_THRESHOLD_US
+    unsigned long skippedEdges[NUMBER_OF_LEDS];          // Edges dropped by LATE_SKIP
+    unsigned long long maxLatenessNanos[NUMBER_OF_LEDS]; // Worst lateness of any edge
+    unsigned long long totalLatenessNanos[NUMBER_OF_LEDS];
+    long long finalDriftNanos[NUMBER_OF_LEDS];           // Actual minus ideal time of the last edge
+    int writeErrors[NUMBER_OF_LEDS];                     // errno of a waveform file that could not be written (0 if it was)
+    unsigned long coalescedWrites;                       // Ticks that updated more than one LED in one writeLedOutputs()
+    long pageFaults;                                     // Page faults the engine thread took while blinking
+} RunResults;
+
+// One experiment on its way through the queue: its configuration, prepared buffers and files, and results
+typedef struct
+{
+    unsigned long id;                                   // Run number, also used in the waveform file names
+    unsigned int frequencies[NUMBER_OF_LEDS];
+    unsigned int brightness[NUMBER_OF_LEDS];
+    unsigned int phases[NUMBER_OF_LEDS];
+    int active[NUMBER_OF_LEDS];                         // Flag to check if the LED blinks in this run
+    unsigned int durationSeconds;                       // Length of the run
+    int latePolicy;                                     // What to do with late edges (LATE_CATCH_UP, LATE_SKIP or LATE_STRETCH)
+    RunBuffers buffers;                                 // Timing tables, records, histograms and output buffers
+    int files[NUMBER_OF_LEDS];                          // Waveform files, created when the experiment is queued (-1 if none)
+    char paths[NUMBER_OF_LEDS][WAVEFORM_PATH_LENGTH];   // Names of the waveform files
+    unsigned long edgesPlanned;                         // Edges in the schedule of every LED together
+    atomic_ulong edgesDone;                             // Edges emitted so far, for the status screen
+    RunResults results;
+} Experiment;
+
 // Function Prototypes
 void setupProgram();
 void startProgram();
@@ -70,29 +215,134 @@ void blinkAll();
 int getBlinkLed();
 int getBlinkFrequency();
 int getBlinkBrightness();
+int getBlinkPhase();
 int confirmBlinkSelection();
-void blinkLedsWithConfig();
-void writeWaveformHeader();
-void writeWaveformData();
+void showStatus();
+void cancelRuns();
+void queueExperiment();
+void *runEngine();
+unsigned long long runExperiment();
+void *runWriter();
+void updateWriterQueueDepth();
+void writeRunReport();
+int cancelExperiments();
+void discardExperiment();
+int engineIdle();
+void startExperimentThreads();
+void stopExperimentThreads();
+unsigned long long phaseOffsetNanos();
+void writeLedOutputs();
+unsigned long long edgeOffsetNanos();
+int edgeState();
+unsigned long countScheduledEdges();
+int parseLatePolicy();
+const char *latePolicyName();
+int prepareRunBuffers();
+void recordEdge();
+unsigned long latenessPercentile();
+int writeWaveformFile();
 void endProgram();
+unsigned long long monotonicNanos();
+void startLedPwm();
+void stopLedPwm();
+void stopIdlePwm();
+int countRunningPwm();
+void waitForMenuInput();
+int readNumber();
+void recordMenuIdle();
+long engineQuietStamp();
+unsigned long countContextSwitches();
+
+// Metrics slots of the engine thread (blink runs) and the writer thread (waveform files)
+MetricsSlot *engineMetrics;
+MetricsSlot *writerMetrics;
+
+// Experiment queue shared by the menu, the engine thread and the writer thread (everything guarded by queueLock)
+pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t engineWake = PTHREAD_COND_INITIALIZER;    // Signalled when a run is queued or the engine should stop
+pthread_cond_t writerWake = PTHREAD_COND_INITIALIZER;    // Signalled when a run has finished or the writer should stop
+Experiment *pendingRuns[EXPERIMENT_QUEUE_LENGTH];        // Runs waiting for the engine, oldest first
+int pendingCount = 0;
+Experiment *finishedRuns[EXPERIMENT_QUEUE_LENGTH];       // Runs waiting for the writer, oldest first
+int finishedCount = 0;
+Experiment *currentRun = NULL;                           // Run the engine is blinking
+unsigned long runsQueued = 0;                            // Run numbers handed out so far
+unsigned long runsStarted = 0;                           // Runs the engine has started
+int engineStopping = FALSE;
+int writerStopping = FALSE;
+atomic_int cancelRequested;                              // Set by the menu to stop the running run
+int lateEdgePolicy = LATE_EDGE_POLICY;                   // Policy given to every run that is queued
+char lastReport[RUN_REPORT_BYTES] = "";                  // Drift report of the last run the writer finished
+pthread_t engineThread;
+pthread_t writerThread;
+
+// PWM state of each LED
+int ledPins[NUMBER_OF_LEDS] = {GREEN_PIN, RED_PIN}; // Pin of each LED
+int pwmRunning[NUMBER_OF_LEDS] = {FALSE, FALSE};    // Flag to check if the softPwm thread of the LED is running
+unsigned int pwmValues[NUMBER_OF_LEDS] = {0, 0};    // Last PWM value written to each LED
+
+// Time spent waiting at the main menu, and the wakeups of every thread meanwhile (index 0 without PWM, 1 with PWM running)
+double menuIdleSeconds[2] = {0, 0};
+unsigned long menuIdleWakeups[2] = {0, 0};
+unsigned long long programStartNanos = 0; // When main() started
+unsigned long long firstMenuNanos = 0;    // When the first menu was shown
 
-// Main Programme
+// Main Programme (left out when BlinkEngineTest.c includes this file to test the engine)
+#ifndef NEW_STUDENT_NO_MAIN
 int main(void)
 {
+    programStartNanos = monotonicNanos();
     setupProgram();
     startProgram();
     endProgram();
     return 0;
 }
+#endif
 
-// Sets up the LED GPIO pins as output and PWM
+// Sets up the LED GPIO pins as output (PWM is only started once something needs it)
 void setupProgram()
 {
-    wiringPiSetupGpio();
-    pinMode(RED_PIN, OUTPUT);
-    pinMode(GREEN_PIN, OUTPUT);
-    softPwmCreate(GREEN_PIN, 0, 100);
-    softPwmCreate(RED_PIN, 0, 100);
+    if (halSetup() < 0)
+    {
+        printf("Error: Could not set up the GPIO pins.\n");
+        exit(1);
+    }
+
+    // Without a stdio buffer on stdin, input typed (or piped) ahead stays in the descriptor, where poll() can see it
+    setvbuf(stdin, NULL, _IONBF, 0);
+    halPinMode(RED_PIN, OUTPUT);
+    halPinMode(GREEN_PIN, OUTPUT);
+
+    // Start publishing the engine metrics
+    const char *channelNames[NUMBER_OF_LEDS] = {"green", "red"};
+    startMetricsReporter(METRICS_FILE, channelNames, NUMBER_OF_LEDS);
+
+    // Start tracing if it was compiled in and requested
+    TRACE_START();
+    TRACE_THREAD("menu");
+
+    // Choosing the late edge policy of every run
+    const char *latePolicy = getenv("BLINK_LATE_POLICY");
+    if (latePolicy != NULL)
+    {
+        lateEdgePolicy = parseLatePolicy(latePolicy);
+        if (lateEdgePolicy < 0)
+        {
+            printf("Error: Unknown late edge policy %s (use catch-up, skip or stretch).\n", latePolicy);
+            exit(1);
+        }
+    }
+
+    // Stream every edge to the monitor while blinking if a telemetry port was named
+    const char *telemetryDevice = getenv("EDGE_TELEMETRY_DEVICE");
+    if (telemetryDevice != NULL)
+    {
+        startEdgeTelemetry(telemetryDevice, TELEMETRY_BAUD);
+    }
+
+    // Start the threads that run and write the queued blink runs
+    startExperimentThreads();
+
     system("clear");
 }
 
@@ -121,6 +371,12 @@ void startProgram()
             break;
         case EXIT:
             break; // Exit the programme
+        case STATUS:
+            showStatus(); // Show the running and queued runs
+            break;
+        case CANCEL:
+            cancelRuns(); // Cancel the running run and drop the queued ones
+            break;
         default:
             system("clear");
             printf("\nInvalid Input. Try Again...\n");
@@ -141,36 +397,76 @@ int getUserSelection()
     // printf("|   |    | |_____   |   |_| ||   |  | ||       ||       ||   |      | |_____   \n");
     // printf("|___|    |_______|  |_______||___|  |_||_______||_______||___|      |_______|  \n");
     printf("\n===== LED STUDENT DEVICE =====\n");
+
+    // Copying the queue state under the lock and printing after, so a slow terminal never holds up the engine
+    pthread_mutex_lock(&queueLock);
+    unsigned long runningId = currentRun != NULL ? currentRun->id : 0;
+    int queued = pendingCount;
+    pthread_mutex_unlock(&queueLock);
+
+    if (runningId != 0)
+    {
+        printf("\nRun %lu blinking, %d queued\n", runningId, queued);
+    }
+    else if (queued > 0)
+    {
+        printf("\n%d queued\n", queued);
+    }
+
     printf("\n[0] Turn off all LEDs\n");
     printf("[1] Turn on all LEDs\n");
     printf("[2] Blink LED\n");
     printf("[3] Blink all LEDs\n");
     printf("[4] Exit\n");
+    printf("[5] Show run status\n");
+    printf("[6] Cancel all runs\n");
     printf("\nYour Selection: ");
-    scanf("%d", &selection);
-    return selection;
+    fflush(stdout);
+
+    if (firstMenuNanos == 0)
+    {
+        firstMenuNanos = monotonicNanos();
+    }
+    waitForMenuInput(); // Stops PWM that has been idle for too long
+    selection = readNumber();
+    return feof(stdin) ? EXIT : selection; // The end of the input exits like [4]
 }
 
 // For troubleshooting, turning off LEDs and PWM. Use this to test the connection of your LED and Pi
 void turnOffLeds()
 {
     system("clear");
+    if (!engineIdle())
+    {
+        printf("\nA run is in progress. Cancel it first or wait for it to finish.\n");
+        return;
+    }
     printf("\nTurning off all LEDs...\n");
-    digitalWrite(GREEN_PIN, LOW);
-    softPwmWrite(GREEN_PIN, 0);
-    digitalWrite(RED_PIN, LOW);
-    softPwmWrite(RED_PIN, 0);
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        pwmValues[i] = 0;
+        stopLedPwm(i); // An LED that is off needs no PWM
+        halDigitalWrite(ledPins[i], LOW);
+    }
 }
 
 // For troubleshooting, turning on LEDs and PWM. Use this to test the connection of your LED and Pi
 void turnOnLeds()
 {
     system("clear");
+    if (!engineIdle())
+    {
+        printf("\nA run is in progress. Cancel it first or wait for it to finish.\n");
+        return;
+    }
     printf("\nTurning on all LEDs...\n");
-    digitalWrite(GREEN_PIN, HIGH);
-    softPwmWrite(GREEN_PIN, 100);
-    digitalWrite(RED_PIN, HIGH);
-    softPwmWrite(RED_PIN, 100);
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        startLedPwm(i);
+        halDigitalWrite(ledPins[i], HIGH);
+        halPwmWrite(ledPins[i], 100);
+        pwmValues[i] = 100;
+    }
 }
 
 // When user wants to blink single LED, this function will get all the blinking configurations
@@ -180,15 +476,15 @@ void blink()
     printf("\nBlink...\n");
     int frequencies[NUMBER_OF_LEDS] = {-1, -1};
     int brightness[NUMBER_OF_LEDS] = {-1, -1};
+    int phases[NUMBER_OF_LEDS] = {0, 0}; // A single LED has nothing to be out of phase with
 
     int led = getBlinkLed();
     frequencies[led] = getBlinkFrequency(led);
     brightness[led] = getBlinkBrightness(led);
 
-    if (confirmBlinkSelection(frequencies, brightness) == CONFIRM)
+    if (confirmBlinkSelection(frequencies, brightness, phases) == CONFIRM)
     {
-        blinkLedsWithConfig(frequencies, brightness);
-        system("clear");
+        queueExperiment(frequencies, brightness, phases); // Runs on the engine thread, so the menu comes straight back
     }
     else
     {
@@ -204,18 +500,19 @@ void blinkAll()
     printf("\nBlink all LEDs...\n");
     int frequencies[NUMBER_OF_LEDS] = {-1, -1}; // Create array of frequency for each LED
     int brightness[NUMBER_OF_LEDS] = {-1, -1}; // Create array of brightness for each LED
+    int phases[NUMBER_OF_LEDS] = {0, 0};       // Create array of phase offset for each LED
 
     // Loop through all LEDs
     for (int i = 0; i < NUMBER_OF_LEDS; i++)
     {
         frequencies[i] = getBlinkFrequency(i); // Assign freqeuncy for each LED
         brightness[i] = getBlinkBrightness(i); // Assign brightness for each LED
+        phases[i] = getBlinkPhase(i);          // Assign phase offset for each LED
     }
 
-    if (confirmBlinkSelection(frequencies, brightness) == CONFIRM)
+    if (confirmBlinkSelection(frequencies, brightness, phases) == CONFIRM)
     {
-        blinkLedsWithConfig(frequencies, brightness);
-        system("clear");
+        queueExperiment(frequencies, brightness, phases); // Runs on the engine thread, so the menu comes straight back
     }
     else
     {
@@ -232,7 +529,7 @@ int getBlinkLed()
     printf("[%i] Green LED\n", GREEN);
     printf("[%i] Red LED\n", RED);
     printf("\nYour Selection: ");
-    scanf("%d", &selection);
+    selection = readNumber();
 
     if (selection != GREEN && selection != RED)
     {
@@ -261,7 +558,7 @@ int getBlinkFrequency(int led)
     }
     printf("Enter whole numbers between 0 to 10\n\n");
     printf("Frequency (Hz): ");
-    scanf("%d", &selection);
+    selection = readNumber();
 
     if (selection < 0 || selection > 10)
     {
@@ -290,7 +587,7 @@ int getBlinkBrightness(int led)
     }
     printf("Enter whole numbers between 0 to 100\n\n");
     printf("Brightness (%%): ");
-    scanf("%d", &selection);
+    selection = readNumber();
 
     if (selection < 0 || selection > 100)
     {
@@ -305,8 +602,37 @@ int getBlinkBrightness(int led)
     }
 }
 
+// Menu to get user selection on LED phase offset (e.g. 0 for one LED and 180 for the other blinks them in anti-phase)
+int getBlinkPhase(int led)
+{
+    int selection;
+    if (led == GREEN)
+    {
+        printf("Enter phase offset to blink green LED.\n\n");
+    }
+    else if (led == RED)
+    {
+        printf("Enter phase offset to blink red LED.\n\n");
+    }
+    printf("Enter whole numbers between 0 to 359\n\n");
+    printf("Phase (degrees): ");
+    selection = readNumber();
+
+    if (selection < 0 || selection > 359)
+    {
+        system("clear");
+        printf("Invalid Input. Try Again...\n\n");
+        return getBlinkPhase(led);
+    }
+    else
+    {
+        system("clear");
+        return selection;
+    }
+}
+
 // Function to confirm the selection of blink configurations for the LEDs
-int confirmBlinkSelection(int frequencies[NUMBER_OF_LEDS], int brightness[NUMBER_OF_LEDS])
+int confirmBlinkSelection(int frequencies[NUMBER_OF_LEDS], int brightness[NUMBER_OF_LEDS], int phases[NUMBER_OF_LEDS])
 {
     int selection; // Variable to store the user's selection
 
@@ -323,164 +649,840 @@ int confirmBlinkSelection(int frequencies[NUMBER_OF_LEDS], int brightness[NUMBER
             printf("%s LED\n", blinkLedString);              // Printing the LED color
             printf("  - Frequency: %dHz\n", frequencies[i]); // Printing the frequency of the LED
             printf("  - Brightness: %d%%\n", brightness[i]); // Printing the brightness of the LED
+            printf("  - Phase: %d degrees\n", phases[i]);   // Printing the phase offset of the LED
         }
     }
     printf("\n[1] Confirm Configuration\n"); // Printing the option for confirming the configuration
     printf("[0] Return to Home\n");          // Printing the option for returning to the home menu
     printf("\nYour Selection: ");
 
-    scanf("%d", &selection); // Taking the user's selection
+    selection = readNumber(); // Taking the user's selection
 
     if (selection < 0 || selection > 1) // Checking if the selection is not within the valid range
     {
-        system("clear");                                // Clearing the screen
-        printf("Invalid Input. Try Again...\n\n");      // Printing a message for invalid input
-        confirmBlinkSelection(frequencies, brightness); // Calling the function again to get valid input
+        system("clear");                                        // Clearing the screen
+        printf("Invalid Input. Try Again...\n\n");              // Printing a message for invalid input
+        confirmBlinkSelection(frequencies, brightness, phases); // Calling the function again to get valid input
     }
     else
         return selection; // Returning the user's selection
 }
 
-// Function to control the blinking of LEDs based on the configurations provided
-void blinkLedsWithConfig(unsigned int frequencies[NUMBER_OF_LEDS], unsigned int brightness[NUMBER_OF_LEDS])
+// Prepares an experiment (timing tables, buffers, waveform files and PWM) and hands it to the engine thread.
+// All of this happens here, while any earlier run is still blinking, so the engine can start it straight after that run
+void queueExperiment(unsigned int frequencies[NUMBER_OF_LEDS], unsigned int brightness[NUMBER_OF_LEDS], unsigned int phases[NUMBER_OF_LEDS])
 {
-    printf("\nBlinking...\n"); // Printing a message indicating that the LEDs are blinking
+    // Limiting the runs in flight (queued, running or waiting for the writer), which also bounds their memory
+    pthread_mutex_lock(&queueLock);
+    int inFlight = pendingCount + finishedCount + (currentRun != NULL);
+    pthread_mutex_unlock(&queueLock);
+    if (inFlight >= EXPERIMENT_QUEUE_LENGTH)
+    {
+        printf("\nQueue full: %d runs are already in progress. Try again once one has finished.\n", inFlight);
+        return;
+    }
 
-    // Initializing arrays to store on and off times for each LED
-    int onTimes[NUMBER_OF_LEDS] = {0, 0};
-    int offTimes[NUMBER_OF_LEDS] = {0, 0};
+    Experiment *experiment = calloc(1, sizeof(Experiment));
+    if (experiment == NULL)
+    {
+        printf("\nRun rejected: not enough memory to queue it.\n");
+        return;
+    }
 
-    // Calculating the on and off times for each LED based on the provided frequency and brightness
+    experiment->id = runsQueued + 1;
     for (int i = 0; i < NUMBER_OF_LEDS; i++)
     {
-        float dutyCycle = (float)brightness[i] / 100.0f;     // Calculating the duty cycle
-        float cycleTime = (frequencies[i] > 0 ? (1.0f / frequencies[i]) : 1.0f) * 1000.0f; // Calculating the time for one cycle (default is one second)
-        onTimes[i] = cycleTime * dutyCycle;                  // Calculating the on-time in milliseconds
-        offTimes[i] = cycleTime * (1.0f - dutyCycle);        // Calculating the off-time in milliseconds
+        experiment->frequencies[i] = frequencies[i];
+        experiment->brightness[i] = brightness[i];
+        experiment->phases[i] = phases[i];
+        experiment->active[i] = (int)frequencies[i] >= 0 && (int)brightness[i] >= 0; // LEDs that were not selected have -1 as their configuration
+        experiment->files[i] = -1;
     }
+    experiment->durationSeconds = BLINK_DURATION;
+    experiment->latePolicy = lateEdgePolicy;
 
-    // Initializing variables for timestamps and the timestamp limit
-    unsigned long timestamps[] = {TIMESTAMP_START, TIMESTAMP_START};          // Initializing the timestamps for each LED (each timestamp will increase with each blink)
-    unsigned long timestampLimit = TIMESTAMP_START + (BLINK_DURATION * 1000); // Setting the timestamp limit
-    int done = FALSE; // Flag to check if timestamp of LED goes over timestamp limit
+    // Taking every buffer of the run from one mapping, or rejecting the run before any LED turns on
+    if (prepareRunBuffers(&experiment->buffers, experiment->frequencies, experiment->brightness, experiment->active, experiment->durationSeconds) < 0)
+    {
+        free(experiment);
+        return;
+    }
 
-    // Flag to check if headers were written for all LED's CSV files
-    int headersWritten = FALSE;
+    // Creating the numbered waveform files now, so the writer only has to write them
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (experiment->active[i])
+        {
+            const char *latest = i == GREEN ? WAVEFORM_FILE_GREEN : WAVEFORM_FILE_RED;
+            snprintf(experiment->paths[i], WAVEFORM_PATH_LENGTH, "%.*s_%03lu.csv", (int)(strlen(latest) - 4), latest, experiment->id);
+            experiment->files[i] = open(experiment->paths[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (experiment->files[i] < 0)
+            {
+                printf("\nRun rejected: could not create %s.\n", experiment->paths[i]);
+                discardExperiment(experiment);
+                return;
+            }
+            experiment->edgesPlanned += experiment->buffers.capacity[i];
+
+            startLedPwm(i); // softPwmCreate() takes a millisecond or more, so it is done here rather than between runs
+        }
+    }
+
+    pthread_mutex_lock(&queueLock);
+    runsQueued++;
+    int ahead = pendingCount + (currentRun != NULL);
+    pendingRuns[pendingCount++] = experiment;
+    pthread_cond_signal(&engineWake);
+    pthread_mutex_unlock(&queueLock);
+
+    printf("\nRun %lu queued with %d run%s ahead of it. Use [5] to follow it.\n", experiment->id, ahead, ahead == 1 ? "" : "s");
+}
+
+// Engine thread: runs the queued experiments one after another. An experiment that is already waiting when the previous
+// one finishes starts on the scheduled end of that run, so back-to-back runs follow each other without a gap
+void *runEngine(void *unused)
+{
+    (void)unused;
+    engineMetrics = registerMetricsThread("engine");
+    TRACE_THREAD("engine");
 
-    // Initializing arrays to store time when LEDs were last blinked and LED states
-    long previousBlinkMillis[NUMBER_OF_LEDS] = {0, 0}; // Storing time when LED was last turned on or off for each LED
-    int ledStates[NUMBER_OF_LEDS] = {LOW, LOW};        // Storing the state of each LED
+    unsigned long long previousEnd = 0;      // Scheduled end of the last run
+    unsigned long long previousLastEdge = 0; // When the engine was done with the last edge of the last run
+    int backToBack = FALSE;                  // Flag to check if the next run was already waiting when the last one finished
 
-    // Looping indefinitely to control the blinking of LEDs
+    pthread_mutex_lock(&queueLock);
+    while (TRUE)
+    {
+        while (pendingCount == 0 && !engineStopping)
+        {
+            backToBack = FALSE;
+            pthread_cond_wait(&engineWake, &queueLock);
+        }
+        if (pendingCount == 0)
+        {
+            break; // Shutting down with nothing left to run
+        }
+
+        Experiment *experiment = pendingRuns[0];
+        pendingCount--;
+        memmove(pendingRuns, pendingRuns + 1, pendingCount * sizeof(Experiment *));
+        currentRun = experiment;
+        runsStarted++;
+        atomic_store(&cancelRequested, FALSE);
+        pthread_mutex_unlock(&queueLock);
+
+        // Arming against a fresh epoch, or against the end of the last run if this one was queued behind it
+        unsigned long long armNanos = halNanos();
+        unsigned long long epoch = armNanos + ARM_DELAY_US * 1000ULL;
+        experiment->results.transitionNanos = -1;
+        experiment->results.gapNanos = -1;
+        if (backToBack)
+        {
+            epoch = previousEnd > armNanos ? previousEnd : armNanos;
+            experiment->results.transitionNanos = armNanos - previousLastEdge;
+            experiment->results.gapNanos = epoch - previousEnd;
+        }
+
+        previousEnd = runExperiment(experiment, epoch);
+        previousLastEdge = halNanos();
+        backToBack = !experiment->results.cancelled;
+
+        // Handing the finished run to the writer thread
+        pthread_mutex_lock(&queueLock);
+        finishedRuns[finishedCount++] = experiment;
+        currentRun = NULL;
+        pthread_cond_signal(&writerWake);
+    }
+    pthread_mutex_unlock(&queueLock);
+    return NULL;
+}
+
+// Runs one experiment against its start epoch
+// Every edge is scheduled against the epoch (epoch + phase offset + edge offset), never against the time the previous edge actually happened,
+// so lateness on one edge does not carry over into the ones after it and every LED keeps its phase relative to the others.
+// Edge times come from the timing tables prepared when the experiment was queued, and nothing is allocated or written to disk here.
+// Returns the scheduled end of the run: the slot after the last edge of the LED that finishes last, including its phase offset
+// and any stretch, which is where a run queued behind this one starts
+unsigned long long runExperiment(Experiment *experiment, unsigned long long epoch)
+{
+    unsigned int *frequencies = experiment->frequencies;
+    unsigned int *brightness = experiment->brightness;
+    RunBuffers *buffers = &experiment->buffers;
+    RunResults *results = &experiment->results;
+
+    unsigned long long lateThresholdNanos = LATE_THRESHOLD_US * 1000ULL;
+    unsigned long long cancelCheckNanos = CANCEL_CHECK_US * 1000ULL;
+
+    // Initializing the schedule of each LED
+    unsigned long long startNanos[NUMBER_OF_LEDS] = {0, 0};       // Epoch plus the phase offset of each LED
+    unsigned long nextEdges[NUMBER_OF_LEDS] = {0, 0};             // Index of the next edge to emit for each LED
+    unsigned long long stretchNanos[NUMBER_OF_LEDS] = {0, 0};     // How far the schedule has been pushed back (LATE_STRETCH only)
+    int ledStates[NUMBER_OF_LEDS] = {LOW, LOW};                   // Storing the state of each LED
+    int active[NUMBER_OF_LEDS] = {FALSE, FALSE};                  // Flag to check if the LED still has edges to emit
+    unsigned long edgesDone = 0;                                  // Edges emitted by every LED together
+
+    long faultsBeforeRun = minorPageFaults();
+
+    // Arming every LED against the shared start epoch
+    int done = TRUE;
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        active[i] = experiment->active[i];
+        if (active[i])
+        {
+            startNanos[i] = epoch + phaseOffsetNanos(frequencies[i], experiment->phases[i]);
+            results->startOffsetNanos[i] = startNanos[i] - epoch;
+            telemetryChannel(i, i == GREEN ? "Green" : "Red", frequencies[i], brightness[i], epoch);
+            done = FALSE;
+        }
+    }
+
+    // Looping until every LED has emitted all of its edges, or the run is cancelled
     while (!done)
     {
-        unsigned long currentMillis = millis(); // Getting the current time in milliseconds
+        if (atomic_load_explicit(&cancelRequested, memory_order_relaxed))
+        {
+            results->cancelled = TRUE;
+            break;
+        }
+
+        // Sleeping until the earliest deadline of any LED
+        unsigned long long nextDeadline = ~0ULL;
+        for (int i = 0; i < NUMBER_OF_LEDS; i++)
+        {
+            if (active[i])
+            {
+                unsigned long long deadline = startNanos[i] + stretchNanos[i] + buffers->offsets[i][nextEdges[i]];
+                nextDeadline = deadline < nextDeadline ? deadline : nextDeadline;
+            }
+        }
+
+        // Long waits are cut into slices, so a cancel from the menu is picked up within CANCEL_CHECK_US
+        unsigned long long sliceEnd = halNanos() + cancelCheckNanos;
+        int sleepError = halSleepUntilNanos(nextDeadline > sliceEnd ? sliceEnd : nextDeadline);
+        if (sleepError != 0)
+        {
+            // Any error other than a signal would come back straight away on every retry, so the run is stopped
+            results->sleepError = sleepError;
+            results->cancelled = TRUE;
+            break;
+        }
+        if (nextDeadline > sliceEnd)
+        {
+            continue;
+        }
+        TRACE_INSTANT("scheduler_wakeup");
+
+        unsigned long long currentNanos = halNanos(); // Getting the current time in nanoseconds
+        unsigned int dueLeds = 0;                     // Bit i is set if LED i has an edge on this tick
 
-        // Checking if it's time to change the LED state (on or off)
+        // Working out which LEDs have an edge due on this tick and what state they change to
         for (int i = 0; i < NUMBER_OF_LEDS; i++)
         {
+            if (!active[i])
+            {
+                continue;
+            }
+
+            unsigned long long deadline = startNanos[i] + stretchNanos[i] + buffers->offsets[i][nextEdges[i]];
+
             // Checking if it's time to change the LED state (on or off)
-            if (currentMillis - previousBlinkMillis[i] >= (ledStates[i] == LOW ? offTimes[i] : onTimes[i]))
+            if (currentNanos >= deadline)
             {
-                previousBlinkMillis[i] = currentMillis; // Updating the previous blink milliseconds
+                unsigned long long latenessNanos = currentNanos - deadline;
 
-                // Handling the LED states based on the brightness values
-                if (brightness[i] == 0)
+                // Applying the late edge policy
+                if (latenessNanos > lateThresholdNanos)
                 {
-                    ledStates[i] = LOW; // Turning the LED off if brightness is 0
-                }
-                else if (brightness[i] == 100)
-                {
-                    ledStates[i] = HIGH; // Turning the LED on at full intensity if brightness is 100
-                }
-                else
-                {
-                    ledStates[i] = (ledStates[i] == LOW) ? HIGH : LOW; // Toggling the LED state based on the current state
-                }
+                    results->lateEdges[i]++;
+                    metricsAdd(&engineMetrics->missedDeadlines, 1);
 
-                // Determining which LED pin is to be used
-                int ledPin = 0;
-                if (i == GREEN)
-                {
-                    ledPin = GREEN_PIN; // Use the green LED pin
+                    if (experiment->latePolicy == LATE_SKIP)
+                    {
+                        // Dropping every slot that has already passed and emitting the most recent one
+                        while (nextEdges[i] + 1 < buffers->capacity[i] && startNanos[i] + stretchNanos[i] + buffers->offsets[i][nextEdges[i] + 1] <= currentNanos)
+                        {
+                            nextEdges[i]++;
+                            results->skippedEdges[i]++;
+                        }
+                        deadline = startNanos[i] + stretchNanos[i] + buffers->offsets[i][nextEdges[i]];
+                        latenessNanos = currentNanos - deadline;
+                    }
+                    else if (experiment->latePolicy == LATE_STRETCH)
+                    {
+                        // Pushing this and every later edge back by the lateness
+                        stretchNanos[i] += latenessNanos;
+                        deadline = currentNanos;
+                        latenessNanos = 0;
+                    }
+                    // LATE_CATCH_UP emits the edge now and keeps the schedule, so any other missed edges follow straight after
                 }
-                else
+
+                // Handling the LED states based on the brightness values and the edge number
+                ledStates[i] = edgeState(brightness[i], nextEdges[i]);
+                dueLeds |= 1u << i;
+
+                // Updating the drift report
+                results->edgesEmitted[i]++;
+                results->totalLatenessNanos[i] += latenessNanos;
+                results->maxLatenessNanos[i] = latenessNanos > results->maxLatenessNanos[i] ? latenessNanos : results->maxLatenessNanos[i];
+                recordEdge(buffers, i, currentNanos - epoch, ledStates[i], latenessNanos);
+                telemetryEdge(i, ledStates[i], currentNanos);
+                metricsMax(&engineMetrics->maxLatenessUs, latenessNanos / 1000);
+                metricsAdd(&engineMetrics->edges[i], 1);
+                results->finalDriftNanos[i] = (long long)(currentNanos - startNanos[i]) - (long long)buffers->offsets[i][nextEdges[i]];
+                edgesDone++;
+            }
+        }
+
+        // Every edge that landed on this tick goes out in one writeLedOutputs() call. Only the raw register backend turns
+        // that into one register store; with wiringPi each pin and each PWM value is still written on its own
+        writeLedOutputs(dueLeds, ledStates, brightness);
+        if (dueLeds & (dueLeds - 1))
+        {
+            results->coalescedWrites++;
+        }
+        atomic_store_explicit(&experiment->edgesDone, edgesDone, memory_order_relaxed);
+
+        done = TRUE;
+        for (int i = 0; i < NUMBER_OF_LEDS; i++)
+        {
+            if (dueLeds & (1u << i))
+            {
+                // Moving on to the next edge, and stopping the LED once its schedule has no edges left
+                nextEdges[i]++;
+                if (nextEdges[i] >= buffers->capacity[i])
                 {
-                    ledPin = RED_PIN; // Use the red LED pin
+                    active[i] = FALSE;
                 }
+            }
 
-                // Setting the LED brightness based on the state
-                softPwmWrite(ledPin, ledStates[i] == HIGH ? brightness[i] : 0); 
-                // Updating the physical state of the LED
-                digitalWrite(ledPin, ledStates[i]);       
+            if (active[i])
+            {
+                done = FALSE;
+            }
+        }
+    }
 
+    results->pageFaults = minorPageFaults() - faultsBeforeRun;
 
-                // Checking if CSV headers were written
-                if (!headersWritten)
-                {
-                    writeWaveformHeader(i, frequencies[i], brightness[i]); // Write waveform header in CSV if not written
-                }                      
-                // Writing waveform data to a file
-                writeWaveformData(i, timestamps[i], ledStates[i]); 
-                // Updating the LED timestamp based on the state
-                timestamps[i] += (ledStates[i] == HIGH) ? onTimes[i] : offTimes[i];
-
-                // Checking if the timestamp limit has been reached, and setting done flag to true if so
-                if (timestamps[i] >= timestampLimit)
-                {
-                    done = TRUE;
-                }    
+    unsigned long long scheduledEnd = epoch;
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (experiment->active[i])
+        {
+            unsigned long long end = startNanos[i] + stretchNanos[i] + buffers->offsets[i][buffers->capacity[i]];
+            scheduledEnd = end > scheduledEnd ? end : scheduledEnd;
+        }
+    }
+    return scheduledEnd;
+}
+
+// Writer thread: writes the waveform files and the drift report of every finished run, then releases the run's memory
+void *runWriter(void *unused)
+{
+    (void)unused;
+    writerMetrics = registerMetricsThread("writer");
+    TRACE_THREAD("writer");
+
+    pthread_mutex_lock(&queueLock);
+    while (TRUE)
+    {
+        updateWriterQueueDepth();
+        while (finishedCount == 0 && !writerStopping)
+        {
+            pthread_cond_wait(&writerWake, &queueLock);
+            updateWriterQueueDepth();
+        }
+        if (finishedCount == 0)
+        {
+            break; // Shutting down with everything written
+        }
+
+        Experiment *experiment = finishedRuns[0];
+        finishedCount--;
+        memmove(finishedRuns, finishedRuns + 1, finishedCount * sizeof(Experiment *));
+        pthread_mutex_unlock(&queueLock);
+
+        // Writing the files first, so the report can say if one of them failed
+        for (int i = 0; i < NUMBER_OF_LEDS; i++)
+        {
+            if (experiment->files[i] >= 0)
+            {
+                experiment->results.writeErrors[i] = writeWaveformFile(experiment, i);
             }
         }
+        char report[RUN_REPORT_BYTES];
+        writeRunReport(experiment, report, sizeof(report));
+        destroyRunArena(&experiment->buffers.arena);
+        free(experiment);
 
-        // Set flag to true after first iteration since headers should have been written then
-        headersWritten = TRUE;
+        pthread_mutex_lock(&queueLock);
+        memcpy(lastReport, report, sizeof(report));
     }
+    pthread_mutex_unlock(&queueLock);
+    return NULL;
 }
 
-/* Add a function to write waveform data of LED to the file */
-void writeWaveformHeader(int led, int blinkFrequency, int blinkDutyCycle)
+// Publishes the number of edge records waiting for the writer (the last run taken off the queue still counts until it is written).
+// Called by the writer thread with queueLock held
+void updateWriterQueueDepth()
 {
-    char ledString[] = "Green";
-    FILE *file;
+    unsigned long waiting = 0;
+    for (int r = 0; r < finishedCount; r++)
+    {
+        for (int i = 0; i < NUMBER_OF_LEDS; i++)
+        {
+            waiting += finishedRuns[r]->buffers.recorded[i];
+        }
+    }
+    metricsSet(&writerMetrics->writerQueueDepth, waiting);
+}
 
-    if (led == GREEN)
+// Formats the drift report of a finished run into report
+void writeRunReport(Experiment *experiment, char *report, size_t size)
+{
+    RunResults *results = &experiment->results;
+    RunBuffers *buffers = &experiment->buffers;
+    FILE *out = fmemopen(report, size, "w");
+    if (out == NULL)
     {
-        file = fopen(WAVEFORM_FILE_GREEN, "w"); // Open file in write mode
+        snprintf(report, size, "Run %lu finished (no memory for its report)\n", experiment->id);
+        return;
     }
-    else
+
+    fprintf(out, "Run %lu%s\n", experiment->id, results->cancelled ? " (cancelled)" : "");
+    if (results->sleepError != 0)
+    {
+        fprintf(out, "Stopped early: waiting for the next edge failed (%s)\n", strerror(results->sleepError));
+    }
+    fprintf(out, "\nDrift report (late edge policy: %s, late threshold: %dus)\n\n", latePolicyName(experiment->latePolicy), LATE_THRESHOLD_US);
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (results->edgesEmitted[i] > 0)
+        {
+            fprintf(out, "%s LED (%uHz, %u%%)\n", i == GREEN ? "Green" : "Red", experiment->frequencies[i], experiment->brightness[i]);
+            fprintf(out, "  - Phase offset: %u degrees (%.1fus after the start epoch)\n", experiment->phases[i], results->startOffsetNanos[i] / 1000.0);
+            fprintf(out, "  - Edges: %lu emitted, %lu late, %lu skipped\n", results->edgesEmitted[i], results->lateEdges[i], results->skippedEdges[i]);
+            fprintf(out, "  - Lateness: %.1fus average, %.1fus max\n", results->totalLatenessNanos[i] / 1000.0 / results->edgesEmitted[i], results->maxLatenessNanos[i] / 1000.0);
+            fprintf(out, "  - Lateness percentiles: 50th under %luus, 99th under %luus\n", latenessPercentile(buffers->histograms[i], buffers->recorded[i], 50), latenessPercentile(buffers->histograms[i], buffers->recorded[i], 99));
+            fprintf(out, "  - Cumulative drift at last edge: %.1fus\n", results->finalDriftNanos[i] / 1000.0);
+        }
+        if (results->writeErrors[i] != 0)
+        {
+            fprintf(out, "  - WARNING: %s could not be written (%s), its data is lost\n", experiment->paths[i], strerror(results->writeErrors[i]));
+        }
+    }
+    fprintf(out, "\nTicks with an edge on more than one LED: %lu (one register store each with HAL_RAW_REGISTERS)\n", results->coalescedWrites);
+    if (results->transitionNanos >= 0)
+    {
+        fprintf(out, "Queued behind run %lu: %.1fus from its last edge to arming this run, started %.1fus after its scheduled end\n", experiment->id - 1, results->transitionNanos / 1000.0, results->gapNanos / 1000.0);
+    }
+    fprintf(out, "Run memory: %zuKB preallocated%s, %ld page faults while blinking, %ldKB peak RSS\n", buffers->arena.size / 1024, buffers->arena.locked ? " and locked" : "", results->pageFaults, peakRssKilobytes());
+    fclose(out);
+}
+
+// Shows the running and queued runs, and the drift report of the last finished run
+void showStatus()
+{
+    // Copying everything shown under the lock and printing after, so a slow terminal never holds up the engine
+    unsigned long runningId = 0;
+    unsigned long edgesDone = 0;
+    unsigned long edgesPlanned = 0;
+    unsigned long queuedIds[EXPERIMENT_QUEUE_LENGTH];
+    char report[RUN_REPORT_BYTES];
+
+    pthread_mutex_lock(&queueLock);
+    if (currentRun != NULL)
+    {
+        runningId = currentRun->id;
+        edgesDone = atomic_load_explicit(&currentRun->edgesDone, memory_order_relaxed);
+        edgesPlanned = currentRun->edgesPlanned;
+    }
+    int queued = pendingCount;
+    for (int r = 0; r < queued; r++)
     {
-        file = fopen(WAVEFORM_FILE_RED, "w"); // Open file in append mode
-        strcpy(ledString, "Red");
+        queuedIds[r] = pendingRuns[r]->id;
     }
+    int unwritten = finishedCount;
+    memcpy(report, lastReport, sizeof(report));
+    pthread_mutex_unlock(&queueLock);
 
-    if (file != NULL)
+    system("clear");
+    printf("\n===== RUN STATUS =====\n\n");
+    if (runningId != 0)
+    {
+        printf("Running: run %lu, %lu of %lu edges emitted%s\n", runningId, edgesDone, edgesPlanned, atomic_load(&cancelRequested) ? " (cancelling)" : "");
+    }
+    else
+    {
+        printf("Running: nothing\n");
+    }
+    printf("Queued: %d", queued);
+    for (int r = 0; r < queued; r++)
     {
-        fprintf(file, "Frequency of %s LED is: %dHz & Duty Cycle of %s LED is: %d%%\n\n", ledString, blinkFrequency, ledString, blinkDutyCycle);
-        fprintf(file, "The timestamp in Millisecond | The state of the %s LED\n", ledString);
-        fclose(file);
+        printf("%s run %lu", r == 0 ? " -" : ",", queuedIds[r]);
     }
+    printf("\nWaiting to be written: %d\n", unwritten);
+    printf("\n===== LAST FINISHED RUN =====\n\n%s", report[0] != '\0' ? report : "None yet\n");
 }
 
-/* Add a function to write waveform data of LED to the file */
-void writeWaveformData(int led, long timestamp, int state)
+// Menu option to cancel the running run and drop every queued one
+void cancelRuns()
 {
-    FILE *file;
+    unsigned long cancelledRun;
+    int droppedCount = cancelExperiments(&cancelledRun);
 
-    if (led == GREEN)
+    system("clear");
+    if (cancelledRun != 0)
     {
-        file = fopen(WAVEFORM_FILE_GREEN, "a"); // Open file in append mode
+        printf("\nCancelled run %lu and dropped %d queued run%s.\n", cancelledRun, droppedCount, droppedCount == 1 ? "" : "s");
     }
     else
     {
-        file = fopen(WAVEFORM_FILE_RED, "a"); // Open file in append mode
+        printf("\nNothing running. Dropped %d queued run%s.\n", droppedCount, droppedCount == 1 ? "" : "s");
+    }
+}
+
+// Cancels the running experiment (its number goes in cancelledRun, 0 if none) and drops every queued one.
+// Whatever the running experiment recorded is still written. Returns the number of queued experiments dropped
+int cancelExperiments(unsigned long *cancelledRun)
+{
+    Experiment *dropped[EXPERIMENT_QUEUE_LENGTH];
+
+    pthread_mutex_lock(&queueLock);
+    int droppedCount = pendingCount;
+    memcpy(dropped, pendingRuns, pendingCount * sizeof(Experiment *));
+    pendingCount = 0;
+    *cancelledRun = 0;
+    if (currentRun != NULL)
+    {
+        *cancelledRun = currentRun->id;
+        atomic_store(&cancelRequested, TRUE);
+    }
+    pthread_mutex_unlock(&queueLock);
+
+    for (int r = 0; r < droppedCount; r++)
+    {
+        discardExperiment(dropped[r]);
+    }
+    return droppedCount;
+}
+
+// Releases an experiment that never ran, removing its empty waveform files
+void discardExperiment(Experiment *experiment)
+{
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (experiment->files[i] >= 0)
+        {
+            close(experiment->files[i]);
+            unlink(experiment->paths[i]);
+        }
+    }
+    destroyRunArena(&experiment->buffers.arena);
+    free(experiment);
+}
+
+// TRUE if nothing is running or queued
+int engineIdle()
+{
+    pthread_mutex_lock(&queueLock);
+    int idle = currentRun == NULL && pendingCount == 0;
+    pthread_mutex_unlock(&queueLock);
+    return idle;
+}
+
+// Starts the engine and writer threads
+void startExperimentThreads()
+{
+    pthread_create(&engineThread, NULL, runEngine, NULL);
+    pthread_create(&writerThread, NULL, runWriter, NULL);
+}
+
+// Cancels whatever is running or queued, then waits for the writer to write out everything that ran
+void stopExperimentThreads()
+{
+    unsigned long cancelledRun;
+    cancelExperiments(&cancelledRun);
+
+    pthread_mutex_lock(&queueLock);
+    engineStopping = TRUE;
+    pthread_cond_signal(&engineWake);
+    pthread_mutex_unlock(&queueLock);
+    pthread_join(engineThread, NULL);
+
+    pthread_mutex_lock(&queueLock);
+    writerStopping = TRUE;
+    pthread_cond_signal(&writerWake);
+    pthread_mutex_unlock(&queueLock);
+    pthread_join(writerThread, NULL);
+}
+
+// Number of edges an LED emits in a run of the given length, using the same edge offsets as the scheduler
+unsigned long countScheduledEdges(unsigned int frequency, unsigned int brightness, unsigned int durationSeconds)
+{
+    unsigned long long durationNanos = durationSeconds * 1000000000ULL;
+    unsigned long edges = 0;
+    while (edgeOffsetNanos(frequency, brightness, edges) < durationNanos)
+    {
+        edges++;
+    }
+    return edges;
+}
+
+// Late edge policy named by text (catch-up, skip or stretch), or -1 if there is no such policy
+int parseLatePolicy(const char *name)
+{
+    if (strcmp(name, "catch-up") == 0)
+    {
+        return LATE_CATCH_UP;
+    }
+    else if (strcmp(name, "skip") == 0)
+    {
+        return LATE_SKIP;
+    }
+    else if (strcmp(name, "stretch") == 0)
+    {
+        return LATE_STRETCH;
+    }
+    return -1;
+}
+
+// Name of a late edge policy, as shown in the drift report
+const char *latePolicyName(int policy)
+{
+    return policy == LATE_SKIP ? "skip" : policy == LATE_STRETCH ? "stretch" : "catch up";
+}
+
+// Sizes every buffer of the run from its schedule and takes them all from one arena.
+// Returns -1 (after telling the user why) if the run does not fit in the available memory
+int prepareRunBuffers(RunBuffers *buffers, unsigned int frequencies[NUMBER_OF_LEDS], unsigned int brightness[NUMBER_OF_LEDS], int active[NUMBER_OF_LEDS], unsigned int durationSeconds)
+{
+    memset(buffers, 0, sizeof(*buffers));
+
+    // Widest row any timestamp can produce, so formatting can never run out of space
+    size_t rowBytes = snprintf(NULL, 0, WAVEFORM_ROW_FORMAT, LONG_MAX, HIGH);
+    size_t totalBytes = 0;
+
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (active[i])
+        {
+            buffers->capacity[i] = countScheduledEdges(frequencies[i], brightness[i], durationSeconds);
+            buffers->outputSizes[i] = WAVEFORM_HEADER_BYTES + buffers->capacity[i] * rowBytes;
+            totalBytes += arenaSize((buffers->capacity[i] + 1) * sizeof(unsigned long long));
+            totalBytes += arenaSize(buffers->capacity[i] * sizeof(EdgeRecord));
+            totalBytes += arenaSize(LATENESS_BUCKETS * sizeof(unsigned long));
+            totalBytes += arenaSize(buffers->outputSizes[i]);
+        }
+    }
+
+    size_t availableBytes = availableMemoryBytes();
+    if (totalBytes > availableBytes)
+    {
+        printf("\nRun rejected: it needs %zuKB but only %zuKB of memory is available.\n", totalBytes / 1024, availableBytes / 1024);
+        return -1;
+    }
+    if (createRunArena(&buffers->arena, totalBytes) < 0)
+    {
+        printf("\nRun rejected: could not map %zuKB for the run.\n", totalBytes / 1024);
+        return -1;
+    }
+
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (active[i])
+        {
+            buffers->offsets[i] = arenaAlloc(&buffers->arena, (buffers->capacity[i] + 1) * sizeof(unsigned long long));
+            buffers->records[i] = arenaAlloc(&buffers->arena, buffers->capacity[i] * sizeof(EdgeRecord));
+
+            // Timing table of the LED, with one entry past the end of the run
+            for (unsigned long e = 0; e <= buffers->capacity[i]; e++)
+            {
+                buffers->offsets[i][e] = edgeOffsetNanos(frequencies[i], brightness[i], e);
+            }
+            buffers->histograms[i] = arenaAlloc(&buffers->arena, LATENESS_BUCKETS * sizeof(unsigned long));
+            buffers->outputs[i] = arenaAlloc(&buffers->arena, buffers->outputSizes[i]);
+        }
+    }
+    return 0;
+}
+
+// Stores one emitted edge and its lateness in the run buffers (never allocates)
+void recordEdge(RunBuffers *buffers, int led, unsigned long long timeNanos, int state, unsigned long long latenessNanos)
+{
+    if (buffers->recorded[led] < buffers->capacity[led])
+    {
+        EdgeRecord *record = &buffers->records[led][buffers->recorded[led]++];
+        record->timeNanos = timeNanos;
+        record->state = state;
+    }
+
+    unsigned long long bucket = latenessNanos / (LATENESS_BUCKET_US * 1000ULL);
+    buffers->histograms[led][bucket < LATENESS_BUCKETS ? bucket : LATENESS_BUCKETS - 1]++;
+}
+
+// Upper bound in microseconds of the lateness of the given percent of edges
+unsigned long latenessPercentile(unsigned long histogram[LATENESS_BUCKETS], unsigned long edges, int percent)
+{
+    unsigned long wanted = (edges * percent + 99) / 100;
+    unsigned long seen = 0;
+    for (int bucket = 0; bucket < LATENESS_BUCKETS; bucket++)
+    {
+        seen += histogram[bucket];
+        if (seen >= wanted)
+        {
+            return (bucket + 1) * LATENESS_BUCKET_US;
+        }
     }
+    return LATENESS_BUCKETS * LATENESS_BUCKET_US;
+}
+
+// Nanoseconds from the start epoch to the first edge of an LED with the given phase offset in degrees
+unsigned long long phaseOffsetNanos(unsigned int frequency, unsigned int phase)
+{
+    unsigned long long hertz = frequency > 0 ? frequency : 1; // Default cycle time is one second
+    return (unsigned long long)phase * 1000000000ULL / (360ULL * hertz);
+}
 
-    if (file != NULL)
+// Writes the state of every LED whose bit is set in dueLeds, back to back with nothing else in between
+void writeLedOutputs(unsigned int dueLeds, int ledStates[NUMBER_OF_LEDS], unsigned int brightness[NUMBER_OF_LEDS])
+{
+    // Setting the LED brightness based on the state
+    TRACE_BEGIN(pwm);
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
     {
-        fprintf(file, "              %d          ,             %d\n", timestamp, state); // The large spacing in between is for neater looks in the CSV file
-        fclose(file);
+        if (dueLeds & (1u << i))
+        {
+            pwmValues[i] = ledStates[i] == HIGH ? brightness[i] : 0;
+            halPwmWrite(ledPins[i], pwmValues[i]);
+        }
     }
+    TRACE_END(pwm, "pwm_update");
+
+    // Updating the physical state of the LEDs (a single register store with the raw register backend, one
+    // digitalWrite per LED with wiringPi)
+    unsigned int setMask = 0;
+    unsigned int clearMask = 0;
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (dueLeds & (1u << i))
+        {
+            if (ledStates[i] == HIGH)
+            {
+                setMask |= 1u << ledPins[i];
+            }
+            else
+            {
+                clearMask |= 1u << ledPins[i];
+            }
+        }
+    }
+    TRACE_BEGIN(gpio);
+    halWritePins(setMask, clearMask);
+    TRACE_END(gpio, "gpio_write");
+}
+
+// Nanoseconds from the start of the run to edge number edge of an LED
+// Computed from the edge number alone, so rounding never accumulates from one edge to the next
+unsigned long long edgeOffsetNanos(unsigned int frequency, unsigned int brightness, unsigned long long edge)
+{
+    unsigned long long hertz = frequency > 0 ? frequency : 1; // Default cycle time is one second
+
+    // A constant LED (0% or 100%) still records one edge per cycle
+    if (brightness == 0 || brightness >= 100)
+    {
+        return edge * 1000000000ULL / hertz;
+    }
+
+    // Even edges turn the LED on at the start of a cycle, odd edges turn it off after the on time
+    unsigned long long percentOfCycles = (edge / 2) * 100 + (edge % 2 == 1 ? brightness : 0);
+    return percentOfCycles * 10000000ULL / hertz; // One percent of a one hertz cycle is 10,000,000ns
+}
+
+// State of an LED after edge number edge
+int edgeState(unsigned int brightness, unsigned long long edge)
+{
+    if (brightness == 0)
+    {
+        return LOW; // Turning the LED off if brightness is 0
+    }
+    else if (brightness >= 100)
+    {
+        return HIGH; // Turning the LED on at full intensity if brightness is 100
+    }
+    return edge % 2 == 0 ? HIGH : LOW; // Toggling the LED state on every edge
+}
+
+// Formats the recorded edges of an LED in its output buffer and writes the whole waveform file of the run with one write.
+// Returns 0 on success, or the errno of the write or close that failed
+int writeWaveformFile(Experiment *experiment, int led)
+{
+    RunBuffers *buffers = &experiment->buffers;
+    int blinkFrequency = experiment->frequencies[led];
+    int blinkDutyCycle = experiment->brightness[led];
+    const char *ledString = led == GREEN ? "Green" : "Red";
+    char *output = buffers->outputs[led];
+    size_t size = buffers->outputSizes[led];
+    size_t length = 0;
+
+    length += snprintf(output + length, size - length, "Frequency of %s LED is: %dHz & Duty Cycle of %s LED is: %d%%\n\n", ledString, blinkFrequency, ledString, blinkDutyCycle);
+    length += snprintf(output + length, size - length, "The timestamp in Millisecond | The state of the %s LED\n", ledString);
+    for (unsigned long e = 0; e < buffers->recorded[led]; e++)
+    {
+        EdgeRecord *record = &buffers->records[led][e];
+        if (length >= size)
+        {
+            break;
+        }
+        length += snprintf(output + length, size - length, WAVEFORM_ROW_FORMAT, TIMESTAMP_START + (long)(record->timeNanos / 1000000ULL), record->state);
+    }
+    int error = length >= size ? EOVERFLOW : 0; // The buffer is sized for every row, so this only happens if that sizing is wrong
+
+    unsigned long long writeStart = monotonicNanos(); // Timing the whole open, write and close
+    TRACE_BEGIN(flush);
+
+    // A regular file normally takes the whole buffer at once, but a short write is carried on rather than lost
+    size_t written = 0;
+    while (error == 0 && written < length)
+    {
+        ssize_t bytes = write(experiment->files[led], output + written, length - written);
+        if (bytes < 0 && errno != EINTR)
+        {
+            error = errno;
+        }
+        written += bytes > 0 ? (size_t)bytes : 0;
+    }
+    if (close(experiment->files[led]) != 0 && error == 0)
+    {
+        error = errno; // e.g. a full disk reported only when the data is flushed
+    }
+    experiment->files[led] = -1;
+    TRACE_END(flush, "file_flush");
+
+    // Recording the write in the writer metrics
+    unsigned long writeNanos = monotonicNanos() - writeStart;
+    metricsAdd(&writerMetrics->bytesWritten, written);
+    metricsAdd(&writerMetrics->writes, 1);
+    metricsAdd(&writerMetrics->writeMicrosTotal, writeNanos / 1000);
+    metricsMax(&writerMetrics->writeNanosMax, writeNanos);
+
+    if (error != 0)
+    {
+        return error; // Leaving the plain file name on the last run that was written completely
+    }
+
+    // Pointing the plain file name at this run, so tools reading the default file see the newest data
+    const char *latest = led == GREEN ? WAVEFORM_FILE_GREEN : WAVEFORM_FILE_RED;
+    char link[WAVEFORM_PATH_LENGTH + 8];
+    snprintf(link, sizeof(link), "%s.link", latest);
+    unlink(link);
+    if (symlink(experiment->paths[led], link) == 0)
+    {
+        rename(link, latest);
+    }
+    return 0;
 }
 
 // Resetting and cleaning up before safely exiting the program
@@ -489,17 +1491,210 @@ void endProgram()
     system("clear");
     printf("\nCleaning Up...\n");
 
-    // Turn Off LEDs
-    digitalWrite(GREEN_PIN, LOW);
-    digitalWrite(RED_PIN, LOW);
+    // Stop the running run, drop the queued ones and wait for everything that ran to be written
+    stopExperimentThreads();
+    stopEdgeTelemetry();
 
     // Turn Off LED Software PWMSS
-    softPwmWrite(GREEN_PIN, 0);
-    softPwmWrite(RED_PIN, 0);
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        pwmValues[i] = 0;
+        stopLedPwm(i);
+    }
+
+    // Turn Off LEDs
+    halDigitalWrite(GREEN_PIN, LOW);
+    halDigitalWrite(RED_PIN, LOW);
 
     // Reset Pins to Original INPUT State
-    pinMode(GREEN_PIN, INPUT);
-    pinMode(RED_PIN, INPUT);
+    halPinMode(GREEN_PIN, INPUT);
+    halPinMode(RED_PIN, INPUT);
+
+    // Write the final metrics snapshot and the trace file
+    stopMetricsReporter();
+    TRACE_STOP();
+    halShutdown();
+
+    // Reporting how quickly the menu came up and how quiet the program was while waiting at it
+    printf("Start to first menu: %.1fms\n", (firstMenuNanos - programStartNanos) / 1000000.0);
+    for (int pwm = 1; pwm >= 0; pwm--)
+    {
+        if (menuIdleSeconds[pwm] > 0)
+        {
+            printf("Idle at the menu with PWM %s: %.1fs, %.1f wakeups/s\n", pwm ? "running" : "stopped", menuIdleSeconds[pwm], menuIdleWakeups[pwm] / menuIdleSeconds[pwm]);
+        }
+    }
 
     printf("Bye!\n\n");
 }
+
+// Current time of the monotonic clock in nanoseconds
+unsigned long long monotonicNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Starts the softPwm thread of an LED if it is not running yet
+void startLedPwm(int led)
+{
+    if (!pwmRunning[led])
+    {
+        halPwmCreate(ledPins[led], 0, 100);
+        pwmRunning[led] = TRUE;
+        pwmValues[led] = 0;
+    }
+}
+
+// Stops the softPwm thread of an LED and holds the pin at the level PWM was giving it (fully on or off)
+void stopLedPwm(int led)
+{
+    if (pwmRunning[led])
+    {
+        halPwmStop(ledPins[led]);
+        pwmRunning[led] = FALSE;
+        halPinMode(ledPins[led], OUTPUT);
+        halDigitalWrite(ledPins[led], pwmValues[led] >= 100 ? HIGH : LOW);
+    }
+}
+
+// Stops PWM on every LED that is fully on or off (an LED at part brightness still needs it)
+void stopIdlePwm()
+{
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        if (pwmValues[i] == 0 || pwmValues[i] >= 100)
+        {
+            stopLedPwm(i);
+        }
+    }
+}
+
+// Number of LEDs with a running softPwm thread
+int countRunningPwm()
+{
+    int running = 0;
+    for (int i = 0; i < NUMBER_OF_LEDS; i++)
+    {
+        running += pwmRunning[i];
+    }
+    return running;
+}
+
+// Waits until there is input for the main menu. If PWM is running, nothing is typed for PWM_IDLE_TIMEOUT_S and no run
+// is in progress, the idle PWM is stopped and the wait carries on. The wakeups of every thread during the wait are recorded
+void waitForMenuInput()
+{
+    struct pollfd input = {STDIN_FILENO, POLLIN, 0};
+    int pwmActive = countRunningPwm() > 0;
+    long quietStamp = engineQuietStamp();
+    unsigned long long waitStart = monotonicNanos();
+    unsigned long switchesAtStart = countContextSwitches();
+
+    while (pwmActive && poll(&input, 1, PWM_IDLE_TIMEOUT_S * 1000) == 0)
+    {
+        if (!engineIdle())
+        {
+            continue; // The run needs its PWM, so check again after another timeout
+        }
+
+        // Closing the measurement while the PWM threads still exist, so their switches are counted
+        recordMenuIdle(pwmActive, waitStart, switchesAtStart, quietStamp);
+        stopIdlePwm();
+
+        pwmActive = countRunningPwm() > 0;
+        quietStamp = engineQuietStamp();
+        waitStart = monotonicNanos();
+        switchesAtStart = countContextSwitches();
+    }
+
+    poll(&input, 1, -1);
+    recordMenuIdle(pwmActive, waitStart, switchesAtStart, quietStamp);
+}
+
+// Reads one line of input and returns the whole number on it, or -1 if the line holds none (or the input has ended).
+// Reading whole lines means no half-read line is left behind for the next prompt, and with stdin unbuffered nothing
+// past the line is taken from the descriptor, so waitForMenuInput() never waits on input that is already here
+int readNumber()
+{
+    char line[64];
+    int number;
+    if (fgets(line, sizeof(line), stdin) == NULL)
+    {
+        return -1;
+    }
+
+    // Dropping the rest of a line too long for the buffer
+    if (strchr(line, '\n') == NULL)
+    {
+        int c;
+        while ((c = getchar()) != '\n' && c != EOF)
+        {
+        }
+    }
+    return sscanf(line, "%d", &number) == 1 ? number : -1;
+}
+
+// Adds the time and wakeups since waitStart to the menu idle statistics, unless a run was in progress at any point since then
+void recordMenuIdle(int pwmActive, unsigned long long waitStart, unsigned long switchesAtStart, long quietStamp)
+{
+    unsigned long switches = countContextSwitches();
+    if (quietStamp < 0 || engineQuietStamp() != quietStamp)
+    {
+        return; // The engine and writer were busy, so their wakeups would be counted too
+    }
+    menuIdleSeconds[pwmActive] += (monotonicNanos() - waitStart) / 1e9;
+    menuIdleWakeups[pwmActive] += switches > switchesAtStart ? switches - switchesAtStart : 0;
+}
+
+// Number of runs started so far if nothing is running, queued or waiting for the writer, otherwise -1.
+// Two equal stamps mean the engine and writer were idle the whole time in between
+long engineQuietStamp()
+{
+    pthread_mutex_lock(&queueLock);
+    long stamp = currentRun == NULL && pendingCount == 0 && finishedCount == 0 ? (long)runsStarted : -1;
+    pthread_mutex_unlock(&queueLock);
+    return stamp;
+}
+
+// Context switches (voluntary and involuntary) of every thread of the process so far. Every wakeup of a sleeping thread is one switch
+unsigned long countContextSwitches()
+{
+    DIR *tasks = opendir("/proc/self/task");
+    if (tasks == NULL)
+    {
+        return 0;
+    }
+
+    unsigned long total = 0;
+    struct dirent *task;
+    while ((task = readdir(tasks)) != NULL)
+    {
+        if (task->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        char path[64];
+        char line[128];
+        snprintf(path, sizeof(path), "/proc/self/task/%.32s/status", task->d_name);
+        FILE *status = fopen(path, "r");
+        if (status == NULL)
+        {
+            continue; // The thread has just exited
+        }
+
+        unsigned long switches;
+        while (fgets(line, sizeof(line), status) != NULL)
+        {
+            if (sscanf(line, "voluntary_ctxt_switches: %lu", &switches) == 1 || sscanf(line, "nonvoluntary_ctxt_switches: %lu", &switches) == 1)
+            {
+                total += switches;
+            }
+        }
+        fclose(status);
+    }
+    closedir(tasks);
+    return total;
+}
@@ -0,0 +1,111 @@
+/*
+=== RUN ARENA ===
+See RunArena.h for how a run uses the arena.
+*/
+
+#define _GNU_SOURCE // MAP_POPULATE
+
+#include "RunArena.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+// Maps size bytes (rounded up to ARENA_ALIGNMENT) with every page already in RAM. Returns 0 on success and -1 on failure
+int createRunArena(RunArena *arena, size_t size)
+{
+    memset(arena, 0, sizeof(*arena));
+    size = arenaSize(size > 0 ? size : 1);
+
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    arena->base = mapping;
+    arena->size = size;
+
+    // Locking needs root or a large enough RLIMIT_MEMLOCK, so the pages are also touched in case it fails
+    arena->locked = mlock(mapping, size) == 0;
+    memset(mapping, 0, size);
+    return 0;
+}
+
+// Hands out the next bytes of the arena, or NULL if the arena is full
+void *arenaAlloc(RunArena *arena, size_t bytes)
+{
+    size_t needed = arenaSize(bytes);
+    if (arena->base == NULL || needed > arena->size - arena->used)
+    {
+        return NULL;
+    }
+
+    void *buffer = arena->base + arena->used;
+    arena->used += needed;
+    return buffer;
+}
+
+// Releases every buffer of the arena at once
+void destroyRunArena(RunArena *arena)
+{
+    if (arena->base != NULL)
+    {
+        if (arena->locked)
+        {
+            munlock(arena->base, arena->size);
+        }
+        munmap(arena->base, arena->size);
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+// MemAvailable from /proc/meminfo in bytes, or (size_t)-1 if it cannot be read (so nothing gets rejected)
+size_t availableMemoryBytes()
+{
+    FILE *file = fopen("/proc/meminfo", "r");
+    if (file == NULL)
+    {
+        return (size_t)-1;
+    }
+
+    char line[128];
+    unsigned long long kilobytes = 0;
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), file) != NULL)
+    {
+        found = sscanf(line, "MemAvailable: %llu kB", &kilobytes) == 1;
+    }
+    fclose(file);
+
+    if (!found)
+    {
+        return (size_t)-1;
+    }
+    return kilobytes * 1024 > (size_t)-1 ? (size_t)-1 : (size_t)(kilobytes * 1024);
+}
+
+// Largest resident set size the process has had so far, in kilobytes
+long peakRssKilobytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Page faults of the calling thread served without disk I/O so far, which is what touching a newly allocated page causes
+long minorPageFaults()
+{
+    struct rusage usage;
+#ifdef RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &usage);
+#else
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+    return usage.ru_minflt;
+}
@@ -0,0 +1,42 @@
+/*
+=== RUN ARENA ===
+One anonymous memory mapping that holds every buffer a blink run needs.
+
+The run works out the size of each buffer from its plan, adds them up with arenaSize(), checks the total against
+availableMemoryBytes() and then creates the arena once. The pages are faulted in (and locked if the limits allow it)
+when the arena is created, and arenaAlloc() only moves a pointer forward, so nothing is allocated and no page
+faults are taken once the run has started. The whole arena is released with one munmap() at the end of the run.
+
+=== HOW TO USE ===
+gcc -o YourTool YourTool.c RunArena.c
+*/
+
+#ifndef RUN_ARENA_H
+#define RUN_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 64 // Every buffer starts on its own cache line
+
+typedef struct
+{
+    unsigned char *base; // Start of the mapping
+    size_t size;         // Size of the mapping in bytes
+    size_t used;         // Bytes handed out so far
+    int locked;          // 1 if the pages are locked in RAM
+} RunArena;
+
+// Space a buffer of the given size takes up in an arena (its size rounded up to ARENA_ALIGNMENT)
+static inline size_t arenaSize(size_t bytes)
+{
+    return (bytes + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+int createRunArena(RunArena *arena, size_t size);
+void *arenaAlloc(RunArena *arena, size_t bytes);
+void destroyRunArena(RunArena *arena);
+size_t availableMemoryBytes();
+long peakRssKilobytes();
+long minorPageFaults();
+
+#endif
@@ -0,0 +1,493 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -o TelemetryMonitor TelemetryMonitor.c
+Step 3: ./TelemetryMonitor [serial device] [baud] [output directory]
+        e.g. ./TelemetryMonitor /dev/ttyAMA0 115200 .   (which are the defaults)
+        ./TelemetryMonitor pty   (no hardware: opens a pseudo terminal pair and prints the device to give the student side)
+Step 4: Ctrl+C to stop and print the summary
+
+=== WHAT IT DOES ===
+Receives the binary edge frames that EdgeTelemetry.c streams from the student device while it blinks (see
+EdgeTelemetry.h for the frame layout) and turns them back into the usual waveform CSV files as the run goes.
+
+Every run announced on a channel gets its own numbered file named after the LED (e.g. green_waveform_data_001.csv)
+with the same header as NewStudent.c, and green_waveform_data.csv points at the newest one. Timestamps are
+in milliseconds from the start of the run with microsecond decimals. The files go into the output directory (created
+if it does not exist). They have the same names NewStudent.c writes, so give a directory of their own when both
+programs run on one machine.
+
+The decoder looks for the sync bytes, checks the length and CRC of every frame and skips ahead one byte at a time
+after a bad frame, so line noise costs at most the frames it touched. Gaps in the frame sequence (frames lost on
+the line) and the edges the student device had to drop are counted and reported at the end.
+
+=== TEST WITHOUT HARDWARE ===
+./TelemetryMonitor pty 115200 monitor   (the decoded files go into monitor/, away from NewStudent's own files)
+EDGE_TELEMETRY_DEVICE=/dev/pts/N ./NewStudent   (with the device printed by the monitor)
+
+=== GPIO PIN CONNECTION ===
+GPIO14 (TXD) to Student GPIO15 (RXD)
+GPIO15 (RXD) to Student GPIO14 (TXD)
+GROUND
+*/
+
+#define _XOPEN_SOURCE 600 // posix_openpt()
+#define _DEFAULT_SOURCE   // cfmakeraw() and symlink()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "EdgeTelemetry.h"
+#include "WaveformCsv.h"
+
+// Definitions
+#define DEFAULT_DEVICE "/dev/ttyAMA0"
+#define DEFAULT_OUTPUT_DIRECTORY "."
+#define STREAM_BUFFER_SIZE 4096   // Received bytes waiting to be decoded
+#define POLL_INTERVAL_MS 200      // How often the receive loop checks for Ctrl+C
+#define TIMESTAMP_START 10000     // Start of timestamp, same as NewStudent.c
+#define PATH_LENGTH 512
+
+// Receiving state of one channel (LED)
+typedef struct
+{
+    char name[TELEMETRY_NAME_LENGTH]; // LED name from the last announcement
+    FILE *file;                       // CSV file of the current run
+    unsigned long long startUs;       // Start of the current run on the sender clock
+    int runs;                         // Runs announced so far
+    unsigned long edges;              // Edges written over all runs
+} Channel;
+
+// Function Prototypes
+int openSerialPort(const char *device, int baud);
+int openPtyPair(int *slave);
+size_t getVarint(const unsigned char *buffer, size_t length, unsigned long long *value);
+size_t decodeStream(const unsigned char *stream, size_t length);
+int handleFrame(int type, const unsigned char *payload, size_t length);
+void startSession();
+int startChannelRun(const unsigned char *payload, size_t length);
+int writeEdges(const unsigned char *payload, size_t length);
+void stopMonitor(int signal);
+
+// Monitor state
+Channel channels[TELEMETRY_MAX_CHANNELS];
+const char *outputDirectory = DEFAULT_OUTPUT_DIRECTORY; // Where the CSV files are written
+volatile sig_atomic_t monitoring = 1;
+int sequenceKnown = 0;
+unsigned char expectedSequence = 0;
+
+// Totals for the summary
+unsigned long long bytesReceived = 0;
+unsigned long framesReceived = 0;
+unsigned long framesLost = 0;
+unsigned long badFrames = 0;
+unsigned long skippedBytes = 0;
+unsigned long edgesDropped = 0;
+unsigned long edgesWithoutRun = 0;
+
+int main(int argc, char *argv[])
+{
+    const char *device = argc > 1 ? argv[1] : DEFAULT_DEVICE;
+    int baud = argc > 2 ? atoi(argv[2]) : TELEMETRY_BAUD;
+    outputDirectory = argc > 3 ? argv[3] : DEFAULT_OUTPUT_DIRECTORY;
+    int port;
+    int slave = -1;
+
+    if (mkdir(outputDirectory, 0755) < 0 && errno != EEXIST)
+    {
+        printf("Error: Could not create the output directory %s.\n", outputDirectory);
+        return 1;
+    }
+
+    if (strcmp(device, "pty") == 0)
+    {
+        port = openPtyPair(&slave);
+    }
+    else
+    {
+        port = openSerialPort(device, baud);
+    }
+    if (port < 0)
+    {
+        printf("Error: Could not open %s.\n", device);
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopMonitor;
+    sigaction(SIGINT, &action, NULL); // Ctrl+C stops receiving but still closes every file properly
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("\nReceiving edge telemetry (Ctrl+C to stop)...\n");
+    fflush(stdout);
+
+    unsigned char stream[STREAM_BUFFER_SIZE];
+    size_t filled = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (monitoring)
+    {
+        struct pollfd waiting = {port, POLLIN, 0};
+        if (poll(&waiting, 1, POLL_INTERVAL_MS) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t bytes = read(port, stream + filled, sizeof(stream) - filled);
+        if (bytes < 0 && errno != EINTR && errno != EAGAIN)
+        {
+            printf("Error: Reading %s failed.\n", device);
+            break;
+        }
+        if (bytes <= 0)
+        {
+            continue;
+        }
+        bytesReceived += (unsigned long long)bytes;
+        filled += (size_t)bytes;
+
+        // Keeping the bytes of an incomplete frame for the next read
+        size_t used = decodeStream(stream, filled);
+        memmove(stream, stream + used, filled - used);
+        filled -= used;
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    close(port);
+    if (slave >= 0)
+    {
+        close(slave);
+    }
+
+    // Reporting what was received, including any losses
+    printf("\n===== TELEMETRY SUMMARY =====\n\n");
+    printf("Frames received: %lu (%llu bytes, %.0f bytes/s)\n", framesReceived, bytesReceived, seconds > 0 ? bytesReceived / seconds : 0.0);
+    printf("Frames lost on the line: %lu\n", framesLost);
+    printf("Frames with a bad CRC or length: %lu (%lu bytes skipped)\n", badFrames, skippedBytes);
+    printf("Edges dropped by the student device: %lu\n", edgesDropped);
+    if (edgesWithoutRun > 0)
+    {
+        printf("Edges of channels that were never announced: %lu\n", edgesWithoutRun);
+    }
+    for (int i = 0; i < TELEMETRY_MAX_CHANNELS; i++)
+    {
+        if (channels[i].runs > 0)
+        {
+            printf("%s: %d run(s), %lu edges\n", channels[i].name, channels[i].runs, channels[i].edges);
+        }
+        if (channels[i].file != NULL)
+        {
+            fclose(channels[i].file);
+        }
+    }
+
+    int lossFree = framesLost == 0 && badFrames == 0 && edgesDropped == 0 && edgesWithoutRun == 0;
+    printf("\n%s\n\n", lossFree ? "No edges were lost." : "WARNING: Edges were lost, the CSV files are incomplete.");
+    return lossFree ? 0 : 2;
+}
+
+// Opens a serial port in raw mode at the given baud rate
+int openSerialPort(const char *device, int baud)
+{
+    int fd = open(device, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    speed_t speed = baud >= 230400 ? B230400 : baud >= 115200 ? B115200 : baud >= 57600 ? B57600 : baud >= 38400 ? B38400 : baud >= 19200 ? B19200 : B9600;
+    struct termios options;
+    tcgetattr(fd, &options);
+    cfmakeraw(&options);
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    options.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(fd, TCSANOW, &options);
+    tcflush(fd, TCIFLUSH); // Dropping anything left over from before the monitor started
+    return fd;
+}
+
+// Opens a pseudo terminal pair and prints the device the student side should write to. Returns the master side
+int openPtyPair(int *slave)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        return -1;
+    }
+
+    // Holding the slave side open too, so the master does not see a hangup between two senders
+    const char *slaveName = ptsname(master);
+    *slave = open(slaveName, O_RDWR | O_NOCTTY);
+    if (*slave < 0)
+    {
+        close(master);
+        return -1;
+    }
+
+    // Raw mode, or the line discipline would rewrite bytes of the frames that happen to look like newlines
+    struct termios options;
+    tcgetattr(*slave, &options);
+    cfmakeraw(&options);
+    tcsetattr(*slave, TCSANOW, &options);
+
+    printf("Telemetry device: %s\n", slaveName);
+    return master;
+}
+
+// Reads one LEB128 varint. Returns the number of bytes it took, or 0 if it runs past the end of the buffer
+size_t getVarint(const unsigned char *buffer, size_t length, unsigned long long *value)
+{
+    *value = 0;
+    for (size_t i = 0; i < length && i < 10; i++)
+    {
+        *value |= (unsigned long long)(buffer[i] & 0x7F) << (7 * i);
+        if ((buffer[i] & 0x80) == 0)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Decodes every complete frame in the buffer. Returns the number of bytes used up
+size_t decodeStream(const unsigned char *stream, size_t length)
+{
+    size_t position = 0;
+
+    while (length - position >= TELEMETRY_HEADER_BYTES)
+    {
+        const unsigned char *frame = stream + position;
+        if (frame[0] != TELEMETRY_SYNC_FIRST || frame[1] != TELEMETRY_SYNC_SECOND)
+        {
+            position++;
+            skippedBytes++;
+            continue;
+        }
+
+        size_t payloadLength = frame[4];
+        size_t total = TELEMETRY_HEADER_BYTES + payloadLength + TELEMETRY_CRC_BYTES;
+        if (length - position < total)
+        {
+            break; // Rest of the frame has not arrived yet
+        }
+
+        // A bad frame may be a sync pattern inside another frame, so only its first byte is skipped
+        unsigned short crc = frame[total - 2] | (unsigned short)(frame[total - 1] << 8);
+        if (crc != telemetryCrc16(frame + 2, TELEMETRY_HEADER_BYTES - 2 + payloadLength) || handleFrame(frame[2], frame + TELEMETRY_HEADER_BYTES, payloadLength) < 0)
+        {
+            badFrames++;
+            position++;
+            skippedBytes++;
+            continue;
+        }
+
+        // Counting the frames the sequence number says went missing
+        if (sequenceKnown && frame[2] != TELEMETRY_FRAME_START)
+        {
+            framesLost += (unsigned char)(frame[3] - expectedSequence);
+        }
+        sequenceKnown = 1;
+        expectedSequence = frame[3] + 1;
+        framesReceived++;
+        position += total;
+    }
+
+    return position;
+}
+
+// Applies one frame that passed its CRC check. Returns 0 on success and -1 if the payload does not make sense
+int handleFrame(int type, const unsigned char *payload, size_t length)
+{
+    switch (type)
+    {
+    case TELEMETRY_FRAME_START:
+        startSession();
+        return 0;
+    case TELEMETRY_FRAME_CHANNEL:
+        return startChannelRun(payload, length);
+    case TELEMETRY_FRAME_EDGES:
+        return writeEdges(payload, length);
+    default:
+        return -1;
+    }
+}
+
+// The sender (re)started: its clock starts over, so runs of the previous session must not receive any more edges
+void startSession()
+{
+    for (int i = 0; i < TELEMETRY_MAX_CHANNELS; i++)
+    {
+        if (channels[i].file != NULL)
+        {
+            fclose(channels[i].file);
+            channels[i].file = NULL;
+        }
+    }
+    printf("Student device connected\n");
+    fflush(stdout);
+}
+
+// Starts a new numbered CSV file for the run announced in the payload
+int startChannelRun(const unsigned char *payload, size_t length)
+{
+    unsigned long long channelNumber, frequency, brightness, startUs;
+    size_t position = 0;
+    size_t used;
+
+    if ((used = getVarint(payload + position, length - position, &channelNumber)) == 0 || channelNumber >= TELEMETRY_MAX_CHANNELS)
+    {
+        return -1;
+    }
+    position += used;
+    if ((used = getVarint(payload + position, length - position, &frequency)) == 0)
+    {
+        return -1;
+    }
+    position += used;
+    if ((used = getVarint(payload + position, length - position, &brightness)) == 0)
+    {
+        return -1;
+    }
+    position += used;
+    if ((used = getVarint(payload + position, length - position, &startUs)) == 0)
+    {
+        return -1;
+    }
+    position += used;
+
+    Channel *channel = &channels[channelNumber];
+    size_t nameLength = length - position < TELEMETRY_NAME_LENGTH - 1 ? length - position : TELEMETRY_NAME_LENGTH - 1;
+    memcpy(channel->name, payload + position, nameLength);
+    channel->name[nameLength] = '\0';
+    if (nameLength == 0)
+    {
+        snprintf(channel->name, sizeof(channel->name), "Channel%llu", channelNumber);
+    }
+
+    // File names use the LED name in lower case, like NewStudent.c (green_waveform_data.csv)
+    char lowerName[TELEMETRY_NAME_LENGTH];
+    for (size_t i = 0; i <= strlen(channel->name); i++)
+    {
+        lowerName[i] = (channel->name[i] >= 'A' && channel->name[i] <= 'Z') ? channel->name[i] - 'A' + 'a' : channel->name[i];
+    }
+
+    if (channel->file != NULL)
+    {
+        fclose(channel->file);
+        channel->file = NULL;
+    }
+    channel->runs++;
+    channel->startUs = startUs;
+
+    char fileName[PATH_LENGTH];
+    char path[PATH_LENGTH * 2];
+    snprintf(fileName, sizeof(fileName), "%s_waveform_data_%03d.csv", lowerName, channel->runs);
+    snprintf(path, sizeof(path), "%s/%s", outputDirectory, fileName);
+    channel->file = fopen(path, "w");
+    if (channel->file == NULL)
+    {
+        printf("Error: Could not create %s.\n", path);
+        channel->runs--;
+        return 0; // The frame itself was fine
+    }
+
+    fprintf(channel->file, "Frequency of %s LED is: %lluHz & Duty Cycle of %s LED is: %llu%%\n\n", channel->name, frequency, channel->name, brightness);
+    fprintf(channel->file, "The timestamp in Millisecond | The state of the %s LED\n", channel->name);
+    fflush(channel->file);
+
+    // Pointing the plain file name at this run, so tools reading the default file see the newest data
+    // (the link sits next to the file, so it points at the bare file name)
+    char latest[PATH_LENGTH * 2];
+    char link[PATH_LENGTH * 2 + 8];
+    snprintf(latest, sizeof(latest), "%s/%s_waveform_data.csv", outputDirectory, lowerName);
+    snprintf(link, sizeof(link), "%s.link", latest);
+    unlink(link);
+    if (symlink(fileName, link) == 0)
+    {
+        rename(link, latest);
+    }
+
+    printf("%s LED: run %d at %lluHz and %llu%% -> %s\n", channel->name, channel->runs, frequency, brightness, path);
+    fflush(stdout);
+    return 0;
+}
+
+// Appends the edges of the payload to the CSV files of their channels
+int writeEdges(const unsigned char *payload, size_t length)
+{
+    unsigned long long dropped, timeUs, deltaUs;
+    size_t position = 0;
+    size_t used;
+
+    if ((used = getVarint(payload + position, length - position, &dropped)) == 0)
+    {
+        return -1;
+    }
+    position += used;
+    if ((used = getVarint(payload + position, length - position, &timeUs)) == 0)
+    {
+        return -1;
+    }
+    position += used;
+
+    // Checking the whole payload before writing anything, so a bad frame never leaves half its edges behind
+    for (size_t check = position; check < length; check += used)
+    {
+        if (((payload[check] >> 1) >= TELEMETRY_MAX_CHANNELS) || (used = getVarint(payload + check + 1, length - check - 1, &deltaUs)) == 0)
+        {
+            return -1;
+        }
+        used++;
+    }
+
+    edgesDropped += dropped;
+    while (position < length)
+    {
+        Channel *channel = &channels[payload[position] >> 1];
+        int state = payload[position] & 1;
+        position++;
+        position += getVarint(payload + position, length - position, &deltaUs);
+        timeUs += deltaUs;
+
+        if (channel->file == NULL)
+        {
+            edgesWithoutRun++;
+            continue;
+        }
+
+        unsigned long long offsetUs = timeUs > channel->startUs ? timeUs - channel->startUs : 0;
+        fprintf(channel->file, WAVEFORM_ROW_FORMAT_PRECISE, TIMESTAMP_START + (long)(offsetUs / 1000), (long)(offsetUs % 1000) * 1000, state);
+        channel->edges++;
+    }
+
+    // Flushing once per frame, so the files can be followed while the run is going
+    for (int i = 0; i < TELEMETRY_MAX_CHANNELS; i++)
+    {
+        if (channels[i].file != NULL)
+        {
+            fflush(channels[i].file);
+        }
+    }
+    return 0;
+}
+
+// Ctrl+C handler
+void stopMonitor(int signal)
+{
+    (void)signal;
+    monitoring = 0;
+}
@@ -0,0 +1,153 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -o WaveformBench WaveformBench.c WaveformCsv.c
+Step 3: ./WaveformBench [rows]
+
+Generates a synthetic waveform CSV in the same layout as writeWaveformFile() in NewStudent.c,
+then compares the fscanf baseline against loadWaveformCsv() and prints the throughput of both.
+*/
+
+#include "WaveformCsv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Definitions
+#define BENCH_FILE "bench_waveform_data.csv" // Temporary file used for the benchmark
+#define DEFAULT_ROWS 2000000                 // Default number of rows (roughly 90MB)
+#define REPEATS 3                            // Best of this many runs is reported
+
+// Function Prototypes
+double nowSeconds();
+int writeBenchFile(long rows);
+long parseWithFscanf(long long *checksum);
+long parseWithIngest(long long *checksum);
+
+int main(int argc, char *argv[])
+{
+    long rows = argc > 1 ? atol(argv[1]) : DEFAULT_ROWS;
+    if (rows <= 0 || writeBenchFile(rows) < 0)
+    {
+        printf("Error: Could not create %s.\n", BENCH_FILE);
+        return 1;
+    }
+
+    WaveformData data;
+    if (loadWaveformCsv(BENCH_FILE, &data) < 0)
+    {
+        printf("Error: Could not load %s.\n", BENCH_FILE);
+        remove(BENCH_FILE);
+        return 1;
+    }
+    double megabytes = data.bytes / 1e6;
+    freeWaveformData(&data);
+
+    double bestFscanf = 1e9;
+    double bestIngest = 1e9;
+    long long fscanfChecksum = 0;
+    long long ingestChecksum = 0;
+
+    for (int i = 0; i < REPEATS; i++)
+    {
+        double start = nowSeconds();
+        long fscanfRows = parseWithFscanf(&fscanfChecksum);
+        double elapsed = nowSeconds() - start;
+        bestFscanf = elapsed < bestFscanf ? elapsed : bestFscanf;
+
+        start = nowSeconds();
+        long ingestRows = parseWithIngest(&ingestChecksum);
+        elapsed = nowSeconds() - start;
+        bestIngest = elapsed < bestIngest ? elapsed : bestIngest;
+
+        // Both parsers must agree before the numbers mean anything
+        if (fscanfRows != rows || ingestRows != rows || fscanfChecksum != ingestChecksum)
+        {
+            printf("Error: Parsers disagree (fscanf %ld rows, ingest %ld rows).\n", fscanfRows, ingestRows);
+            remove(BENCH_FILE);
+            return 1;
+        }
+    }
+
+    printf("\n===== WAVEFORM INGEST BENCHMARK =====\n");
+    printf("\nRows: %ld (%.1f MB)\n", rows, megabytes);
+    printf("fscanf          : %8.1f ms  %8.1f MB/s\n", bestFscanf * 1000, megabytes / bestFscanf);
+    printf("loadWaveformCsv : %8.1f ms  %8.1f MB/s\n", bestIngest * 1000, megabytes / bestIngest);
+    printf("Speedup         : %8.1fx\n\n", bestFscanf / bestIngest);
+
+    remove(BENCH_FILE);
+    return 0;
+}
+
+// Monotonic time in seconds
+double nowSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Writes a square wave with the same header and padding as NewStudent.c
+int writeBenchFile(long rows)
+{
+    FILE *file = fopen(BENCH_FILE, "w");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    fprintf(file, "Frequency of Green LED is: 10Hz & Duty Cycle of Green LED is: 50%%\n\n");
+    fprintf(file, "The timestamp in Millisecond | The state of the Green LED\n");
+    for (long i = 0; i < rows; i++)
+    {
+        fprintf(file, WAVEFORM_ROW_FORMAT, 10000 + i * 50, (int)(i % 2 == 0));
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// Baseline: the obvious stdio parser
+long parseWithFscanf(long long *checksum)
+{
+    FILE *file = fopen(BENCH_FILE, "r");
+    char line[256];
+    long rows = 0;
+    long timestamp;
+    int state;
+
+    *checksum = 0;
+    for (int i = 0; i < 3; i++) // Title, blank line and column labels
+    {
+        fgets(line, sizeof(line), file);
+    }
+    while (fscanf(file, " %ld , %d", &timestamp, &state) == 2)
+    {
+        *checksum += timestamp * NANOS_PER_MILLI + state;
+        rows++;
+    }
+
+    fclose(file);
+    return rows;
+}
+
+// Shared ingest library
+long parseWithIngest(long long *checksum)
+{
+    WaveformData data;
+    *checksum = 0;
+    if (loadWaveformCsv(BENCH_FILE, &data) < 0)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < data.count; i++)
+    {
+        *checksum += data.timestampsNs[i] + data.states[i];
+    }
+
+    long rows = data.count;
+    freeWaveformData(&data);
+    return rows;
+}
@@ -0,0 +1,306 @@
+/*
+=== WAVEFORM CSV INGEST ===
+See WaveformCsv.h for the file layout.
+
+The file is memory-mapped (read into memory on Windows) and parsed in two passes:
+  1. Count the newlines with SIMD compares so that both columns can be allocated exactly once
+  2. Walk the rows, skipping the whitespace padding 16 bytes at a time and parsing the digits by hand
+*/
+
+#include "WaveformCsv.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WAVEFORM_NO_MMAP
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Function Prototypes
+static size_t countNewlines(const char *p, const char *end);
+static const char *skipSpaces(const char *p, const char *end);
+static const char *nextLine(const char *p, const char *end);
+static const char *parseRow(const char *p, const char *end, long long *timestampNs, int *state);
+static int parseRows(const char *begin, const char *end, WaveformData *data);
+
+// Loads the waveform CSV file at path into data. Returns 0 on success and -1 on failure (errno is set)
+int loadWaveformCsv(const char *path, WaveformData *data)
+{
+    memset(data, 0, sizeof(*data));
+
+#ifdef WAVEFORM_NO_MMAP
+    // No mmap on Windows, so read the whole file into one buffer instead
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *buffer = malloc(size > 0 ? size : 1);
+    if (buffer == NULL || fread(buffer, 1, size, file) != (size_t)size)
+    {
+        free(buffer);
+        fclose(file);
+        errno = EIO;
+        return -1;
+    }
+    fclose(file);
+
+    data->bytes = size;
+    int result = parseRows(buffer, buffer + size, data);
+    free(buffer);
+    return result;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    data->bytes = info.st_size;
+    if (info.st_size == 0) // mmap rejects empty files, and there is nothing to parse anyway
+    {
+        close(fd);
+        return 0;
+    }
+
+    char *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid after the descriptor is closed
+    if (mapping == MAP_FAILED)
+    {
+        return -1;
+    }
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL); // Let the kernel read ahead aggressively
+
+    int result = parseRows(mapping, mapping + info.st_size, data);
+    munmap(mapping, info.st_size);
+    return result;
+#endif
+}
+
+// Releases the columns allocated by loadWaveformCsv()
+void freeWaveformData(WaveformData *data)
+{
+    free(data->timestampsNs);
+    free(data->states);
+    data->timestampsNs = NULL;
+    data->states = NULL;
+    data->count = 0;
+}
+
+// Counts the '\n' characters between p and end
+static size_t countNewlines(const char *p, const char *end)
+{
+    size_t count = 0;
+
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        p += 16;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    while (end - p >= 16)
+    {
+        uint8x16_t matches = vceqq_u8(vld1q_u8((const uint8_t *)p), newline); // 0xFF for every newline
+        count += vaddvq_u8(vshrq_n_u8(matches, 7));                          // 1 per newline, summed across lanes
+        p += 16;
+    }
+#endif
+
+    // Scalar tail (and the whole buffer when no SIMD is available)
+    while (p < end)
+    {
+        count += (*p++ == '\n');
+    }
+    return count;
+}
+
+// Returns the first character at or after p that is not a space or tab
+static const char *skipSpaces(const char *p, const char *end)
+{
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        unsigned int notSpace = ~_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, space)) & 0xFFFF;
+        if (notSpace)
+        {
+            p += __builtin_ctz(notSpace);
+            break;
+        }
+        p += 16;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint8x16_t space = vdupq_n_u8(' ');
+    while (end - p >= 16 && vminvq_u8(vceqq_u8(vld1q_u8((const uint8_t *)p), space)) == 0xFF)
+    {
+        p += 16; // All 16 bytes are padding
+    }
+#endif
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    return p;
+}
+
+// Returns the start of the line after the one containing p (or end if there is none)
+static const char *nextLine(const char *p, const char *end)
+{
+    if (p >= end)
+    {
+        return end;
+    }
+    const char *newline = memchr(p, '\n', end - p); // memchr is already vectorised by the C library
+    return newline != NULL ? newline + 1 : end;
+}
+
+// Parses one "timestamp , state" row starting at p. Returns the end of the parsed row or NULL if it is malformed
+static const char *parseRow(const char *p, const char *end, long long *timestampNs, int *state)
+{
+    p = skipSpaces(p, end);
+    if (p >= end || *p < '0' || *p > '9')
+    {
+        return NULL;
+    }
+
+    // Whole milliseconds
+    long long millis = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        millis = millis * 10 + (*p++ - '0');
+    }
+
+    // Optional fractional milliseconds, kept down to the nanosecond
+    long long fraction = 0;
+    if (p < end && *p == '.')
+    {
+        long long scale = NANOS_PER_MILLI;
+        p++;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            scale /= 10;
+            fraction += (*p++ - '0') * scale; // Digits past the nanosecond have a scale of 0 and are dropped
+        }
+    }
+
+    p = skipSpaces(p, end);
+    if (p >= end || *p != ',')
+    {
+        return NULL;
+    }
+    p = skipSpaces(p + 1, end);
+    if (p >= end || *p < '0' || *p > '9')
+    {
+        return NULL;
+    }
+
+    int value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (*p++ - '0');
+    }
+
+    *timestampNs = millis * NANOS_PER_MILLI + fraction;
+    *state = value;
+    return p;
+}
+
+// Parses the title, skips the header block and fills both columns
+static int parseRows(const char *begin, const char *end, WaveformData *data)
+{
+    const char *p = begin;
+
+    // Line 1 is the dataset title
+    const char *titleEnd = nextLine(p, end);
+    size_t titleLength = titleEnd - p;
+    while (titleLength > 0 && (p[titleLength - 1] == '\n' || p[titleLength - 1] == '\r'))
+    {
+        titleLength--;
+    }
+    if (titleLength >= WAVEFORM_TITLE_LENGTH)
+    {
+        titleLength = WAVEFORM_TITLE_LENGTH - 1;
+    }
+    memcpy(data->title, p, titleLength);
+    data->title[titleLength] = '\0';
+    p = titleEnd;
+
+    // Skip the blank line and the column labels (anything that does not start with a digit)
+    while (p < end)
+    {
+        const char *first = skipSpaces(p, end);
+        if (first < end && *first >= '0' && *first <= '9')
+        {
+            break;
+        }
+        p = nextLine(p, end);
+    }
+
+    // One row per remaining line (plus one in case the last line has no newline)
+    size_t capacity = countNewlines(p, end) + 1;
+    data->timestampsNs = malloc(capacity * sizeof(*data->timestampsNs));
+    data->states = malloc(capacity * sizeof(*data->states));
+    if (data->timestampsNs == NULL || data->states == NULL)
+    {
+        freeWaveformData(data);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while (p < end)
+    {
+        long long timestampNs;
+        int state;
+        const char *rowEnd = parseRow(p, end, &timestampNs, &state);
+
+        if (rowEnd != NULL)
+        {
+            data->timestampsNs[data->count] = timestampNs;
+            data->states[data->count] = state;
+            data->count++;
+            p = nextLine(rowEnd, end);
+        }
+        else
+        {
+            const char *lineEnd = nextLine(p, end);
+            const char *first = skipSpaces(p, lineEnd);
+            if (first < lineEnd && *first != '\n' && *first != '\r')
+            {
+                data->skipped++; // Only count rows that actually had content
+            }
+            p = lineEnd;
+        }
+    }
+
+    return 0;
+}
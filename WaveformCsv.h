@@ -0,0 +1,45 @@
+/*
+=== WAVEFORM CSV INGEST ===
+Shared loader for the waveform CSV files written by writeWaveformFile() in NewStudent.c
+
+File layout:
+  Line 1   : Dataset title (e.g. "Frequency of Green LED is: 5Hz & Duty Cycle of Green LED is: 50%")
+  Line 2   : Blank
+  Line 3   : Column labels
+  Line 4.. : "              <timestamp>          ,             <state>"
+
+The timestamp column is in milliseconds and may carry an optional fractional part (e.g. "10000.125").
+Timestamps are returned in nanoseconds so that sub-millisecond recordings keep their precision.
+
+=== HOW TO USE ===
+gcc -O2 -o YourTool YourTool.c WaveformCsv.c
+*/
+
+#ifndef WAVEFORM_CSV_H
+#define WAVEFORM_CSV_H
+
+#include <stddef.h>
+
+#define WAVEFORM_TITLE_LENGTH 256 // Maximum length of the dataset title (including '\0')
+#define NANOS_PER_MILLI 1000000LL // Nanoseconds in one millisecond
+
+// Row layout shared by every tool that writes waveform data (the large spacing is for neater looks in the CSV file)
+#define WAVEFORM_ROW_FORMAT "              %ld          ,             %d\n"
+// Same layout with nanosecond precision: whole milliseconds, nanoseconds within the millisecond, state
+#define WAVEFORM_ROW_FORMAT_PRECISE "              %ld.%06ld          ,             %d\n"
+
+// Parsed contents of one waveform CSV file
+typedef struct
+{
+    char title[WAVEFORM_TITLE_LENGTH]; // First line of the file without the newline
+    long long *timestampsNs;           // Timestamp column converted to nanoseconds
+    int *states;                       // State column (0 = LOW, 1 = HIGH)
+    size_t count;                      // Number of rows parsed
+    size_t skipped;                    // Number of malformed rows that were ignored
+    size_t bytes;                      // Size of the file in bytes
+} WaveformData;
+
+int loadWaveformCsv(const char *path, WaveformData *data);
+void freeWaveformData(WaveformData *data);
+
+#endif
@@ -0,0 +1,257 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -o WaveformReplay WaveformReplay.c WaveformCsv.c GpioHal.c -lwiringPi
+Step 3: ./WaveformReplay [file.csv:gpio pin ...]
+        e.g. ./WaveformReplay green_waveform_data.csv:13 red_waveform_data.csv:27   (the defaults)
+
+To build and run without a Raspberry Pi (virtual time, every pin write recorded), use the simulated backend:
+gcc -O2 -DHAL_SIMULATED -o WaveformReplay WaveformReplay.c WaveformCsv.c GpioHal.c -lpthread
+HAL_SIM_LOG=calls.txt ./WaveformReplay
+
+=== WHAT IT DOES ===
+Reproduces recorded waveforms on the bench. Every file is loaded and parsed before playback starts, and the edges
+of all files are merged by timestamp into one stream that a single scheduler plays back against one start epoch.
+No file is touched once the first edge goes out, so parsing and disk I/O can never delay an edge. Edges of
+different pins recorded at the same instant go out in one halWritePins() call. Each file must have its rows in
+time order, which is checked while loading.
+
+Rows that repeat the current state of a pin (e.g. the per-cycle rows of a 0% or 100% LED) are replayed as writes
+too, so the pin is driven exactly as it was recorded.
+
+At the end the replay error of every edge (actual minus recorded time) is summarised.
+*/
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "GpioHal.h" // GPIO and clock backend (wiringPi unless chosen otherwise at compile time)
+#include "WaveformCsv.h"
+
+// Definitions
+#define MAX_REPLAY_FILES 8   // Maximum number of recordings replayed together
+#define ARM_DELAY_US 100000  // Time between the end of loading and the first edge
+
+// One edge of the merged stream
+typedef struct
+{
+    long long offsetNs; // Time after the first recorded edge of any file
+    int pin;            // GPIO pin to drive
+    int state;          // State to drive it to
+} ReplayEdge;
+
+// Function Prototypes
+size_t mergeRecordings(WaveformData recordings[], int pins[], int fileCount, ReplayEdge *stream);
+int compareErrors(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    char *defaults[] = {argv[0], "green_waveform_data.csv:13", "red_waveform_data.csv:27"};
+    if (argc < 2)
+    {
+        argc = 3;
+        argv = defaults;
+    }
+
+    if (argc - 1 > MAX_REPLAY_FILES)
+    {
+        printf("Error: %d files given, but at most %d can be replayed together.\n", argc - 1, MAX_REPLAY_FILES);
+        return 1;
+    }
+
+    WaveformData recordings[MAX_REPLAY_FILES];
+    int pins[MAX_REPLAY_FILES];
+    int fileCount = 0;
+    size_t totalEdges = 0;
+
+    // Loading every recording up front
+    for (int i = 1; i < argc; i++)
+    {
+        char path[256];
+        strncpy(path, argv[i], sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+
+        char *separator = strrchr(path, ':');
+        if (separator == NULL)
+        {
+            printf("Error: %s should be given as file.csv:gpio pin.\n", argv[i]);
+            return 1;
+        }
+        *separator = '\0';
+        pins[fileCount] = atoi(separator + 1);
+        if (pins[fileCount] < 0 || pins[fileCount] > 31)
+        {
+            printf("Error: GPIO%d is out of range (GPIO0 to GPIO31).\n", pins[fileCount]);
+            return 1;
+        }
+
+        if (loadWaveformCsv(path, &recordings[fileCount]) < 0 || recordings[fileCount].count == 0)
+        {
+            printf("Error: No waveform data in %s.\n", path);
+            return 1;
+        }
+
+        // The merge takes the rows of each file in order, so a row earlier than the one before it would be replayed late
+        WaveformData *recording = &recordings[fileCount];
+        for (size_t row = 1; row < recording->count; row++)
+        {
+            if (recording->timestampsNs[row] < recording->timestampsNs[row - 1])
+            {
+                printf("Error: %s is not in time order: edge %zu (%.6fms) comes before edge %zu (%.6fms).\n", path, row + 1, recording->timestampsNs[row] / 1e6, row, recording->timestampsNs[row - 1] / 1e6);
+                return 1;
+            }
+        }
+        printf("%s -> GPIO%d (%zu edges)\n", recordings[fileCount].title, pins[fileCount], recordings[fileCount].count);
+        totalEdges += recordings[fileCount].count;
+        fileCount++;
+    }
+
+    // Merging all recordings into one stream, and preallocating the error of every edge
+    ReplayEdge *stream = malloc(totalEdges * sizeof(ReplayEdge));
+    long long *errorsNs = calloc(totalEdges, sizeof(long long));
+    if (stream == NULL || errorsNs == NULL)
+    {
+        printf("Error: Not enough memory to replay %zu edges.\n", totalEdges);
+        return 1;
+    }
+    mergeRecordings(recordings, pins, fileCount, stream);
+    for (int i = 0; i < fileCount; i++)
+    {
+        freeWaveformData(&recordings[i]);
+    }
+
+    // Keeping every page in RAM so playback never page faults
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+
+    if (halSetup() < 0)
+    {
+        printf("Error: Could not set up the GPIO pins.\n");
+        free(stream);
+        free(errorsNs);
+        return 1;
+    }
+    struct sched_param priority = {.sched_priority = sched_get_priority_max(SCHED_FIFO)};
+    sched_setscheduler(0, SCHED_FIFO, &priority); // Real-time priority if running as root
+    for (int i = 0; i < fileCount; i++)
+    {
+        halPinMode(pins[i], OUTPUT);
+    }
+
+    printf("\nReplaying %zu edges over %.3fs...\n", totalEdges, stream[totalEdges - 1].offsetNs / 1e9);
+
+    // Playing the stream back against one start epoch
+    unsigned long long epoch = halNanos() + ARM_DELAY_US * 1000ULL;
+    int sleepError = 0;
+    size_t e = 0;
+    while (e < totalEdges)
+    {
+        unsigned long long deadline = epoch + stream[e].offsetNs;
+        sleepError = halSleepUntilNanos(deadline);
+        if (sleepError != 0)
+        {
+            printf("Error: Waiting for edge %zu failed (%s), replay stopped.\n", e, strerror(sleepError));
+            totalEdges = e;
+            break;
+        }
+
+        // Every edge recorded at this instant goes out in one write (the last row of a pin wins)
+        size_t first = e;
+        unsigned int setMask = 0;
+        unsigned int clearMask = 0;
+        for (; e < totalEdges && stream[e].offsetNs == stream[first].offsetNs; e++)
+        {
+            unsigned int bit = 1u << stream[e].pin;
+            setMask = stream[e].state ? setMask | bit : setMask & ~bit;
+            clearMask = stream[e].state ? clearMask & ~bit : clearMask | bit;
+        }
+        halWritePins(setMask, clearMask);
+
+        long long errorNs = (long long)(halNanos() - deadline);
+        for (size_t k = first; k < e; k++)
+        {
+            errorsNs[k] = errorNs;
+        }
+    }
+
+    // Releasing the pins
+    for (int i = 0; i < fileCount; i++)
+    {
+        halDigitalWrite(pins[i], LOW);
+        halPinMode(pins[i], INPUT);
+    }
+    halShutdown();
+    munlockall();
+
+    if (totalEdges == 0)
+    {
+        free(stream);
+        free(errorsNs);
+        return 1;
+    }
+
+    // Summarising the replay error
+    long long totalErrorNs = 0;
+    for (size_t e = 0; e < totalEdges; e++)
+    {
+        totalErrorNs += errorsNs[e];
+    }
+    qsort(errorsNs, totalEdges, sizeof(long long), compareErrors);
+
+    printf("\n===== REPLAY ERROR =====\n\n");
+    printf("Edges replayed: %zu\n", totalEdges);
+    printf("Average: %.1fus\n", totalErrorNs / 1000.0 / totalEdges);
+    printf("Median : %.1fus\n", errorsNs[totalEdges / 2] / 1000.0);
+    printf("99th   : %.1fus\n", errorsNs[totalEdges * 99 / 100] / 1000.0);
+    printf("Max    : %.1fus\n\n", errorsNs[totalEdges - 1] / 1000.0);
+
+    free(stream);
+    free(errorsNs);
+    return sleepError != 0 ? 1 : 0;
+}
+
+// Merges the edges of every recording by timestamp into stream. Returns the number of edges
+size_t mergeRecordings(WaveformData recordings[], int pins[], int fileCount, ReplayEdge *stream)
+{
+    size_t positions[MAX_REPLAY_FILES] = {0};
+    long long firstNs = recordings[0].timestampsNs[0];
+    size_t count = 0;
+
+    for (int i = 1; i < fileCount; i++)
+    {
+        firstNs = recordings[i].timestampsNs[0] < firstNs ? recordings[i].timestampsNs[0] : firstNs;
+    }
+
+    while (1)
+    {
+        // Picking the recording with the earliest next edge (ties go to the earlier file)
+        int next = -1;
+        for (int i = 0; i < fileCount; i++)
+        {
+            if (positions[i] < recordings[i].count &&
+                (next < 0 || recordings[i].timestampsNs[positions[i]] < recordings[next].timestampsNs[positions[next]]))
+            {
+                next = i;
+            }
+        }
+        if (next < 0)
+        {
+            return count;
+        }
+
+        stream[count].offsetNs = recordings[next].timestampsNs[positions[next]] - firstNs;
+        stream[count].pin = pins[next];
+        stream[count].state = recordings[next].states[positions[next]] ? HIGH : LOW;
+        positions[next]++;
+        count++;
+    }
+}
+
+// Ascending order for qsort()
+int compareErrors(const void *a, const void *b)
+{
+    long long difference = *(const long long *)a - *(const long long *)b;
+    return (difference > 0) - (difference < 0);
+}
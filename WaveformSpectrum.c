@@ -0,0 +1,391 @@
+/*
+=== HOW TO RUN ===
+Step 1: cd into C file location
+Step 2: gcc -O2 -o WaveformSpectrum WaveformSpectrum.c WaveformCsv.c Fft.c -lm
+        (add -mfpu=neon on 32-bit Raspberry Pi OS)
+Step 3: ./WaveformSpectrum <file.csv> [sample rate in Hz] [points per segment]
+        e.g. ./WaveformSpectrum green_waveform_data.csv 10000 65536   (the defaults)
+
+=== WHAT IT DOES ===
+Shows the frequency content of a waveform recording. The edges are resampled onto a uniform grid (the state of
+the LED at each sample time), the mean is removed, and the grid is cut into segments that overlap by half.
+Each segment is multiplied by a Hann window and transformed with the FFT in Fft.c, and the power of all segments
+is averaged (Welch's method), so long captures give a smoother spectrum rather than a bigger one.
+
+Reported:
+  - the fundamental (strongest peak), refined between bins
+  - the first harmonics against what the measured duty cycle predicts for a square wave, |sin(pi n D)| / n
+    (a 50% duty cycle has no even harmonics)
+  - spurious peaks: anything within SPURIOUS_FLOOR_DB of the fundamental that is not a harmonic of it,
+    e.g. the ~100Hz softPwm carrier beating against the blink frequency
+
+The averaged spectrum is also written to <file>_spectrum.csv (frequency in Hz, level in dB relative to the fundamental).
+A recording that never changes state has no AC power, so there is no fundamental: that is reported and nothing is written.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Fft.h"
+#include "WaveformCsv.h"
+
+// Definitions
+#define DEFAULT_SAMPLE_RATE 10000   // Hz, enough for the first 50 harmonics of a 100Hz PWM carrier
+#define DEFAULT_SEGMENT_POINTS 65536 // FFT size, rounded down to a power of 2
+#define MIN_SEGMENT_POINTS 256       // Smallest FFT worth reporting
+#define HARMONICS_SHOWN 10           // Harmonics compared against the duty cycle
+#define HARMONIC_TOLERANCE_BINS 3    // Distance from n * fundamental still counted as that harmonic
+#define SPURIOUS_FLOOR_DB -40.0      // Peaks below this (relative to the fundamental) are not reported
+#define MAX_SPURIOUS_PEAKS 10        // Spurious peaks listed
+#define AC_POWER_EPSILON 1e-12       // Total AC power at or below this counts as a constant recording
+#define POWER_FLOOR 1e-30            // Smallest power passed to log10, so an empty bin gives a finite level
+
+// One peak of the spectrum
+typedef struct
+{
+    double frequency; // Hz
+    double level;     // dB relative to the fundamental
+} SpectrumPeak;
+
+// Function Prototypes
+double monotonicSeconds();
+float *resampleWaveform(const WaveformData *data, double sampleRate, size_t *sampleCount, double *duty);
+int averagePower(const float *samples, size_t sampleCount, size_t points, double *power, size_t *segments);
+double peakFrequency(const double *power, size_t bin, double binWidth);
+double bandPower(const double *power, size_t bins, double frequency, double binWidth);
+double levelDb(double power, double reference);
+int isHarmonic(double frequency, double fundamental, double binWidth);
+int compareLevels(const void *a, const void *b);
+void writeSpectrum(const char *path, const char *title, const double *power, size_t bins, double binWidth, double reference);
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <file.csv> [sample rate in Hz] [points per segment]\n", argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[1];
+    double sampleRate = argc > 2 ? atof(argv[2]) : DEFAULT_SAMPLE_RATE;
+    size_t points = argc > 3 ? (size_t)atol(argv[3]) : DEFAULT_SEGMENT_POINTS;
+    if (sampleRate <= 0)
+    {
+        printf("Error: The sample rate must be above 0Hz.\n");
+        return 1;
+    }
+
+    WaveformData data;
+    if (loadWaveformCsv(path, &data) < 0 || data.count < 2)
+    {
+        printf("Error: No waveform data in %s.\n", path);
+        return 1;
+    }
+
+    size_t sampleCount;
+    double duty;
+    float *samples = resampleWaveform(&data, sampleRate, &sampleCount, &duty);
+    if (samples == NULL)
+    {
+        printf("Error: Not enough memory to resample %s.\n", path);
+        return 1;
+    }
+
+    // Rounding the segment down to a power of 2 that fits in the recording
+    size_t wanted = points;
+    points = MIN_SEGMENT_POINTS;
+    while (points * 2 <= wanted && points * 2 <= sampleCount)
+    {
+        points *= 2;
+    }
+    if (points > sampleCount)
+    {
+        printf("Error: %s only gives %zu samples at %.0fHz, at least %d are needed.\n", path, sampleCount, sampleRate, MIN_SEGMENT_POINTS);
+        return 1;
+    }
+
+    size_t bins = points / 2 + 1;
+    double binWidth = sampleRate / points;
+    double *power = calloc(bins, sizeof(double));
+    size_t segments;
+
+    double startTime = monotonicSeconds();
+    if (power == NULL || averagePower(samples, sampleCount, points, power, &segments) < 0)
+    {
+        printf("Error: Not enough memory for a %zu point FFT.\n", points);
+        return 1;
+    }
+    double elapsed = monotonicSeconds() - startTime;
+
+    printf("\n===== SPECTRUM =====\n\n");
+    printf("%s\n", data.title);
+    printf("%zu edges over %.3fs, resampled at %.0fHz (%zu samples)\n", data.count, (data.timestampsNs[data.count - 1] - data.timestampsNs[0]) / 1e9, sampleRate, sampleCount);
+    printf("%zu segments of %zu points averaged, %.4fHz per bin, %.1fms\n", segments, points, binWidth, elapsed * 1000);
+    printf("Duty cycle : %.1f%%\n", duty * 100);
+
+    // A constant recording leaves nothing once the mean is removed, and every level would be relative to zero
+    double acPower = 0;
+    for (size_t k = 1; k < bins; k++)
+    {
+        acPower += power[k];
+    }
+    if (acPower <= AC_POWER_EPSILON)
+    {
+        printf("No AC content: the state never changes within the analysed segments, so there is no fundamental.\n\n");
+        free(power);
+        free(samples);
+        freeWaveformData(&data);
+        return 0;
+    }
+
+    // The fundamental is the strongest bin, skipping DC and the bin the window spreads it into
+    size_t fundamentalBin = 2;
+    for (size_t k = 3; k < bins - 1; k++)
+    {
+        if (power[k] > power[fundamentalBin])
+        {
+            fundamentalBin = k;
+        }
+    }
+    double fundamental = peakFrequency(power, fundamentalBin, binWidth);
+    double reference = power[fundamentalBin];
+
+    printf("Fundamental: %.3fHz\n", fundamental);
+
+    // Harmonics against the square wave the duty cycle predicts
+    printf("\n Harmonic   Frequency    Measured    Expected\n");
+    double fundamentalWeight = fabs(sin(M_PI * duty));
+    for (int n = 1; n <= HARMONICS_SHOWN && n * fundamental < sampleRate / 2; n++)
+    {
+        double measured = levelDb(bandPower(power, bins, n * fundamental, binWidth), reference);
+        double weight = fabs(sin(M_PI * n * duty)) / n;
+
+        printf("%9d %10.3fHz %9.1fdB ", n, n * fundamental, measured);
+        if (fundamentalWeight > 0 && weight > 1e-3 * fundamentalWeight)
+        {
+            printf("%9.1fdB\n", 20 * log10(weight / fundamentalWeight));
+        }
+        else
+        {
+            printf("%11s\n", "null");
+        }
+    }
+
+    // Local maxima that are not a harmonic of the fundamental
+    SpectrumPeak spurious[MAX_SPURIOUS_PEAKS + 1];
+    size_t spuriousCount = 0;
+    for (size_t k = 2; k < bins - 1; k++)
+    {
+        if (power[k] <= power[k - 1] || power[k] < power[k + 1])
+        {
+            continue;
+        }
+
+        double level = levelDb(power[k], reference);
+        double frequency = peakFrequency(power, k, binWidth);
+        if (level < SPURIOUS_FLOOR_DB || isHarmonic(frequency, fundamental, binWidth))
+        {
+            continue;
+        }
+
+        // Keeping the strongest few, in descending order
+        size_t position = spuriousCount < MAX_SPURIOUS_PEAKS ? spuriousCount++ : MAX_SPURIOUS_PEAKS;
+        spurious[position].frequency = frequency;
+        spurious[position].level = level;
+        qsort(spurious, position + 1, sizeof(SpectrumPeak), compareLevels);
+    }
+
+    printf("\nSpurious peaks above %.0fdB: %zu%s\n", SPURIOUS_FLOOR_DB, spuriousCount, spuriousCount == MAX_SPURIOUS_PEAKS ? " (strongest shown)" : "");
+    for (size_t i = 0; i < spuriousCount; i++)
+    {
+        printf("  %10.3fHz %9.1fdB\n", spurious[i].frequency, spurious[i].level);
+    }
+
+    // Writing the spectrum next to the recording
+    char spectrumPath[512];
+    size_t stem = strlen(path);
+    if (stem > 4 && strcmp(path + stem - 4, ".csv") == 0)
+    {
+        stem -= 4;
+    }
+    snprintf(spectrumPath, sizeof(spectrumPath), "%.*s_spectrum.csv", (int)stem, path);
+    writeSpectrum(spectrumPath, data.title, power, bins, binWidth, reference);
+    printf("\nSpectrum written to %s\n\n", spectrumPath);
+
+    free(power);
+    free(samples);
+    freeWaveformData(&data);
+    return 0;
+}
+
+// Current time of the monotonic clock in seconds
+double monotonicSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Samples the state of the recording at sampleRate from its first row to its last. Returns NULL if memory ran out
+float *resampleWaveform(const WaveformData *data, double sampleRate, size_t *sampleCount, double *duty)
+{
+    long long firstNs = data->timestampsNs[0];
+    double durationNs = (double)(data->timestampsNs[data->count - 1] - firstNs);
+    size_t count = (size_t)(durationNs * sampleRate / 1e9) + 1;
+
+    float *samples = malloc(count * sizeof(float));
+    if (samples == NULL)
+    {
+        return NULL;
+    }
+
+    // Holding the state of the last row at or before each sample time
+    double stepNs = 1e9 / sampleRate;
+    size_t row = 0;
+    double high = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        long long timeNs = firstNs + (long long)(i * stepNs);
+        while (row + 1 < data->count && data->timestampsNs[row + 1] <= timeNs)
+        {
+            row++;
+        }
+        samples[i] = data->states[row] ? 1.0f : 0.0f;
+        high += samples[i];
+    }
+
+    *sampleCount = count;
+    *duty = high / count;
+    return samples;
+}
+
+// Averages the power spectrum of Hann windowed, half overlapping segments into power (points / 2 + 1 bins).
+// Returns 0 on success and -1 if memory ran out
+int averagePower(const float *samples, size_t sampleCount, size_t points, double *power, size_t *segments)
+{
+    Fft fft;
+    float *window = malloc(points * sizeof(float));
+    float *re = malloc(points * sizeof(float));
+    float *im = malloc(points * sizeof(float));
+    if (window == NULL || re == NULL || im == NULL || createFft(&fft, points) < 0)
+    {
+        free(window);
+        free(re);
+        free(im);
+        return -1;
+    }
+
+    double windowSum = 0;
+    for (size_t i = 0; i < points; i++)
+    {
+        window[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / points));
+        windowSum += window[i];
+    }
+
+    double mean = 0;
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        mean += samples[i];
+    }
+    mean /= sampleCount;
+
+    size_t hop = points / 2;
+    size_t count = 0;
+    for (size_t start = 0; start + points <= sampleCount; start += hop)
+    {
+        for (size_t i = 0; i < points; i++)
+        {
+            re[i] = (float)((samples[start + i] - mean) * window[i]);
+            im[i] = 0.0f;
+        }
+        runFft(&fft, re, im);
+
+        for (size_t k = 0; k < points / 2 + 1; k++)
+        {
+            power[k] += (double)re[k] * re[k] + (double)im[k] * im[k];
+        }
+        count++;
+    }
+
+    // Scaling so each bin holds the squared amplitude of a sine at that frequency
+    double scale = 4.0 / (windowSum * windowSum * count);
+    for (size_t k = 0; k < points / 2 + 1; k++)
+    {
+        power[k] *= scale;
+    }
+
+    *segments = count;
+    destroyFft(&fft);
+    free(window);
+    free(re);
+    free(im);
+    return 0;
+}
+
+// Frequency of the peak at bin, refined with a parabola through the log power of it and its neighbours
+double peakFrequency(const double *power, size_t bin, double binWidth)
+{
+    double left = log(power[bin - 1] + 1e-30);
+    double centre = log(power[bin] + 1e-30);
+    double right = log(power[bin + 1] + 1e-30);
+    double curve = left - 2 * centre + right;
+    double offset = curve < 0 ? 0.5 * (left - right) / curve : 0;
+    return (bin + offset) * binWidth;
+}
+
+// Strongest power within HARMONIC_TOLERANCE_BINS of frequency
+double bandPower(const double *power, size_t bins, double frequency, double binWidth)
+{
+    long centre = lround(frequency / binWidth);
+    double strongest = 0;
+    for (long k = centre - HARMONIC_TOLERANCE_BINS; k <= centre + HARMONIC_TOLERANCE_BINS; k++)
+    {
+        if (k >= 0 && k < (long)bins && power[k] > strongest)
+        {
+            strongest = power[k];
+        }
+    }
+    return strongest;
+}
+
+// Level of power in dB relative to reference, with both held above POWER_FLOOR so neither can give inf or NaN
+double levelDb(double power, double reference)
+{
+    return 10 * log10(fmax(power, POWER_FLOOR) / fmax(reference, POWER_FLOOR));
+}
+
+// 1 if frequency is within HARMONIC_TOLERANCE_BINS of a multiple of the fundamental
+int isHarmonic(double frequency, double fundamental, double binWidth)
+{
+    double multiple = round(frequency / fundamental);
+    return multiple >= 1 && fabs(frequency - multiple * fundamental) <= HARMONIC_TOLERANCE_BINS * binWidth;
+}
+
+// Descending level order for qsort()
+int compareLevels(const void *a, const void *b)
+{
+    double difference = ((const SpectrumPeak *)b)->level - ((const SpectrumPeak *)a)->level;
+    return (difference > 0) - (difference < 0);
+}
+
+// Writes the spectrum in the same title / blank / labels / rows layout as the waveform files
+void writeSpectrum(const char *path, const char *title, const double *power, size_t bins, double binWidth, double reference)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Error: Could not write %s.\n", path);
+        return;
+    }
+
+    fprintf(file, "Spectrum of %s\n\n", title);
+    fprintf(file, "Frequency (Hz), Level (dB)\n");
+    for (size_t k = 0; k < bins; k++)
+    {
+        fprintf(file, "              %.4f          ,             %.2f\n", k * binWidth, levelDb(power[k], reference));
+    }
+    fclose(file);
+}
@@ -1,9 +1,19 @@
 /* 
 === HOW TO RUN ===
 Step 1: cd into C file location
-Step 2: gcc -o student student.c -lwiringPi
+Step 2: gcc -o student student.c GpioHal.c BlinkTrace.c EdgeTelemetry.c -lwiringPi -lpthread
 Step 3: ./student
 
+To build without a Raspberry Pi, add -DHAL_SIMULATED and drop -lwiringPi (see GpioHal.h)
+
+=== EDGE TELEMETRY ===
+Run with EDGE_TELEMETRY_DEVICE=/dev/ttyAMA0 ./student to stream every edge to the monitor once the handshake is done.
+The handshake closes the port first, and the port is closed again when the blink ends. Decode it with TelemetryMonitor.c
+
+=== TRACE CAPTURE ===
+Build with -DBLINK_TRACE and run with BLINK_TRACE_FILE=trace.json ./student
+On exit, trace.json holds a Chrome trace-event timeline of the serial handshake, GPIO writes and PWM updates.
+
 === PRE-REQUISITES ===
 Install wiringPi: https://learn.sparkfun.com/tutorials/raspberry-gpio/c-wiringpi-setup
 softPwm is installed with wiringPi
@@ -31,15 +41,16 @@ VERSION="10 (buster)"
 VERSION_CODENAME=buster
 */
 
-#include <wiringPi.h>
-#include <softPwm.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <wiringSerial.h>
 #include <unistd.h>
 
+#include "BlinkTrace.h"
+#include "EdgeTelemetry.h"
+#include "GpioHal.h"
+
 /* DEFINITIONS */
 #define RED 27      // GPIO Pin 27
 #define GREEN 13    // GPIO Pin 13
@@ -87,11 +98,15 @@ int main(void) {
 Sets up the LED GPIO pins as output and PWM
 */
 void setupProgram() {
-    wiringPiSetupGpio();
-    pinMode(RED, OUTPUT);
-    pinMode(GREEN, OUTPUT);
-    softPwmCreate(GREEN, 0, 100);
-    softPwmCreate(RED, 0, 100);
+    if (halSetup() < 0) {
+        printf("Error: Could not set up the GPIO pins.\n");
+        exit(1);
+    }
+    halPinMode(RED, OUTPUT);
+    halPinMode(GREEN, OUTPUT);
+    halPwmCreate(GREEN, 0, 100);
+    halPwmCreate(RED, 0, 100);
+    TRACE_START();
     system("clear");
 }
 
@@ -153,10 +168,10 @@ For troubleshooting, turning off LEDs and PWM
 void turnOffLeds() {
     system("clear");
     printf("\nTurning off both LEDs...\n");
-    digitalWrite(GREEN, LOW);
-    softPwmWrite(GREEN, 0);
-    digitalWrite(RED, LOW);
-    softPwmWrite(RED, 0);
+    halDigitalWrite(GREEN, LOW);
+    halPwmWrite(GREEN, 0);
+    halDigitalWrite(RED, LOW);
+    halPwmWrite(RED, 0);
 }
 
 /* 
@@ -165,10 +180,10 @@ For troubleshooting, turning on LEDs and PWM at 100
 void turnOnLeds() {
     system("clear");
     printf("\nTurning on both LEDs...\n");
-    digitalWrite(GREEN, HIGH);
-    softPwmWrite(GREEN, 100);
-    digitalWrite(RED, HIGH);
-    softPwmWrite(RED, 100);
+    halDigitalWrite(GREEN, HIGH);
+    halPwmWrite(GREEN, 100);
+    halDigitalWrite(RED, HIGH);
+    halPwmWrite(RED, 100);
 }
 
 /* 
@@ -318,18 +333,24 @@ int connectToMonitorDevice(int blinkLed, int blinkFrequency, int blinkBrightness
     sprintf(blinkBrightnessString, "%d", blinkBrightness);
 
     // Open the serial port
-    serial_port = serialOpen("/dev/ttyAMA0", 9600);
+    TRACE_BEGIN(serialOpen);
+    serial_port = halSerialOpen("/dev/ttyAMA0", 9600);
+    TRACE_END(serialOpen, "serial_open");
     if (serial_port < 0) {
     fprintf(stderr, "Error opening serial port\n");
         return -1;
     }
 
     // Write data to the serial port
-    serialPuts(serial_port, studentid);
+    TRACE_BEGIN(serialWrite);
+    halSerialPuts(serial_port, studentid);
+    TRACE_END(serialWrite, "serial_write");
 
     // Read data from the serial port
     char buffer[256];
+    TRACE_BEGIN(serialRead);
     int n = read(serial_port, buffer, sizeof(buffer));
+    TRACE_END(serialRead, "serial_read");
     buffer[n] = '\0';
 
     if (strlen(buffer) == 7) {
@@ -337,24 +358,30 @@ int connectToMonitorDevice(int blinkLed, int blinkFrequency, int blinkBrightness
     } else return -1;    
 
     // Send Blink Configuration
-    serialPuts(serial_port, blinkLedString);
+    TRACE_BEGIN(blinkLedString);
+    halSerialPuts(serial_port, blinkLedString);
     n = read(serial_port, buffer, sizeof(buffer));
+    TRACE_END(blinkLedString, "serial_exchange");
     buffer[n] = '\0';
     printf("%s\n", buffer);
 
-    serialPuts(serial_port, blinkFrequencyString);
+    TRACE_BEGIN(blinkFrequencyString);
+    halSerialPuts(serial_port, blinkFrequencyString);
     n = read(serial_port, buffer, sizeof(buffer));
+    TRACE_END(blinkFrequencyString, "serial_exchange");
     buffer[n] = '\0';
     printf("%s\n", buffer);
 
-    serialPuts(serial_port, blinkBrightnessString);
+    TRACE_BEGIN(blinkBrightnessString);
+    halSerialPuts(serial_port, blinkBrightnessString);
     n = read(serial_port, buffer, sizeof(buffer));
+    TRACE_END(blinkBrightnessString, "serial_exchange");
     buffer[n] = '\0';
     printf("%s\n", buffer);
 
-    serialClose(serial_port);
+    halSerialClose(serial_port);
     printf("Connection Successful!\n");
-    delay(5000);
+    halDelay(5000);
     return 1;
 }
 
@@ -368,6 +395,11 @@ void blinkLedWithConfig(int blinkLed, int blinkFrequency, int blinkBrightness) {
     // Setting Frequency
     float onOffTime = 1.0f / blinkFrequency * 1000;
 
+    // Streaming the edges to the monitor over the UART the handshake has just released, if asked for
+    int channel = blinkLed == BLINK_GREEN ? 0 : 1;
+    startEdgeTelemetry(getenv("EDGE_TELEMETRY_DEVICE"), TELEMETRY_BAUD);
+    telemetryChannel(channel, blinkLed == BLINK_GREEN ? "Green" : "Red", blinkFrequency, blinkBrightness, halNanos());
+
     // Setting Blink LED
     if (blinkLed == BLINK_GREEN) {
         blinkLed = GREEN;
@@ -379,22 +411,30 @@ void blinkLedWithConfig(int blinkLed, int blinkFrequency, int blinkBrightness) {
 
     for (int blink = 0; blink < 20;)
     {
-        unsigned long currentMillis = millis();
+        unsigned long currentMillis = halMillis();
 
         if (currentMillis - previousMillis >= onOffTime) {
+            TRACE_INSTANT("scheduler_wakeup");
             previousMillis = currentMillis;
+            TRACE_BEGIN(pwm);
             if (ledState == LOW) {
                 ledState = HIGH;
-                softPwmWrite(blinkLed, blinkBrightness);
+                halPwmWrite(blinkLed, blinkBrightness);
             } else {
                 ledState = LOW;
-                softPwmWrite(blinkLed, 0);
+                halPwmWrite(blinkLed, 0);
             }
+            TRACE_END(pwm, "pwm_update");
             blink++;
-            digitalWrite(blinkLed, ledState);
+            TRACE_BEGIN(gpio);
+            halDigitalWrite(blinkLed, ledState);
+            TRACE_END(gpio, "gpio_write");
+            telemetryEdge(channel, ledState, halNanos());
         }
     }
 
+    stopEdgeTelemetry();
+
 }
 
 /* 
@@ -404,16 +444,18 @@ void endProgram() {
     system("clear");
     printf("\nCleaning Up...\n");
     // Turn Off LEDs
-    digitalWrite(GREEN, LOW);
-    digitalWrite(RED, LOW);
+    halDigitalWrite(GREEN, LOW);
+    halDigitalWrite(RED, LOW);
 
     // Turn Off LED Software PWM
-    softPwmWrite(GREEN, 0);
-    softPwmWrite(RED, 0);
+    halPwmWrite(GREEN, 0);
+    halPwmWrite(RED, 0);
 
     // Reset Pins to Original INPUT State
-    pinMode(GREEN, INPUT);
-    pinMode(RED, INPUT);
+    halPinMode(GREEN, INPUT);
+    halPinMode(RED, INPUT);
 
+    TRACE_STOP();
+    halShutdown();
     printf("Bye!\n\n");
 }
\ No newline at end of file